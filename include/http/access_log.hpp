@@ -0,0 +1,154 @@
+#ifndef ACCESS_LOG_HPP
+#define ACCESS_LOG_HPP
+
+#include "../log/log.hpp"
+#include <boost/beast/http/verb.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief One completed request, as recorded by an HTTP session.
+ * 
+ * Fixed-size so that recording it never allocates; long targets are truncated.
+ */
+struct access_entry
+{
+    static constexpr std::size_t max_target = 128;  ///< Longest target kept
+
+    std::chrono::system_clock::time_point time;     ///< When the response finished
+    boost::beast::http::verb method = boost::beast::http::verb::unknown; ///< Request method
+    unsigned status = 0;                            ///< Response status code
+    std::uint64_t bytes = 0;                        ///< Response bytes written
+    std::uint32_t parse_us = 0;                     ///< First request bytes to request parsed
+    std::uint32_t handle_us = 0;                    ///< Time spent in handle_request
+    std::uint32_t write_us = 0;                     ///< Start of the write to completion
+    std::uint16_t target_size = 0;                  ///< Length of target
+    char target[max_target];                        ///< Request target, possibly truncated
+
+    /**
+     * @brief Copy (and truncate) the request target.
+     * 
+     * @param t The request target.
+     */
+    void set_target(std::string_view t)
+    {
+        target_size = static_cast<std::uint16_t>(std::min(t.size(), max_target));
+        t.copy(target, target_size);
+    }
+};
+
+/**
+ * @brief Microseconds between two steady clock readings, saturated to 32 bits.
+ */
+inline std::uint32_t elapsed_us(
+    std::chrono::steady_clock::time_point from,
+    std::chrono::steady_clock::time_point to)
+{
+    auto const us = std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+    return static_cast<std::uint32_t>(std::clamp<long long>(us, 0, static_cast<long long>(UINT32_MAX)));
+}
+
+/**
+ * @brief Batched, structured HTTP access log.
+ * 
+ * I/O threads record entries into a preallocated ring owned by the thread, with no
+ * locks or allocations. A background thread drains all rings periodically (or early
+ * when a ring fills up), formats the entries as JSON lines and writes each batch with
+ * one call into a Logger from LoggerManager. Entries are dropped, and the drops
+ * counted, if a ring is full.
+ */
+class access_log
+{
+public:
+    /**
+     * @brief Access the shared access log instance.
+     * 
+     * @return A reference to the process-wide access log.
+     */
+    static access_log& instance();
+
+    /**
+     * @brief Enable the access log and start the flusher thread.
+     * 
+     * Must be called before the I/O threads start serving requests.
+     * 
+     * @param logger The logger that receives the formatted batches.
+     * @param interval How often the rings are drained.
+     */
+    void configure(std::shared_ptr<Logger> logger, std::chrono::milliseconds interval = std::chrono::seconds(1));
+
+    /**
+     * @brief Check whether the access log is enabled.
+     * 
+     * @return True once configure() has been called.
+     */
+    bool enabled() const
+    {
+        return logger_ != nullptr;
+    }
+
+    /**
+     * @brief Record a completed request from the calling I/O thread.
+     * 
+     * @param entry The entry to record.
+     */
+    void record(access_entry const& entry);
+
+    access_log(access_log const&) = delete;
+    access_log& operator=(access_log const&) = delete;
+
+    ~access_log();
+
+private:
+    access_log() = default;
+
+    /**
+     * @brief Single-producer, single-consumer ring owned by one I/O thread.
+     */
+    struct ring
+    {
+        static constexpr std::size_t capacity = 1024;       ///< Entries per ring, a power of two
+
+        std::array<access_entry, capacity> entries;         ///< Preallocated entries
+        alignas(64) std::atomic<std::size_t> head{0};       ///< Next entry written by the producer
+        alignas(64) std::atomic<std::size_t> tail{0};       ///< Next entry read by the flusher
+        std::atomic<std::uint64_t> dropped{0};              ///< Entries dropped because the ring was full
+    };
+
+    /**
+     * @brief Get the calling thread's ring, registering it on first use.
+     */
+    ring& local_ring();
+
+    /**
+     * @brief Drain every ring and write the formatted batch.
+     */
+    void flush();
+
+    /**
+     * @brief Flusher thread loop.
+     */
+    void run();
+
+    std::shared_ptr<Logger> logger_;                    ///< Destination of the batches, null when disabled
+    std::chrono::milliseconds interval_{1000};          ///< Flush interval
+    std::mutex mutex_;                                  ///< Protects rings_ and the wakeup state
+    std::condition_variable wakeup_;                    ///< Wakes the flusher early or for shutdown
+    bool stop_ = false;                                 ///< Set on shutdown
+    std::atomic<bool> flush_requested_{false};          ///< Set by a producer whose ring is filling up
+    std::vector<std::unique_ptr<ring>> rings_;          ///< One ring per I/O thread
+    std::string batch_;                                 ///< Reused formatting buffer
+    std::thread thread_;                                ///< The flusher thread
+};
+
+#endif // ACCESS_LOG_HPP
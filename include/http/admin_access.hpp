@@ -0,0 +1,64 @@
+#ifndef ADMIN_ACCESS_HPP
+#define ADMIN_ACCESS_HPP
+
+#include <boost/asio/ip/address.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Allow-list of client networks that may use the admin endpoints.
+ *
+ * The admin endpoints are served on the public listener, so requests for them from
+ * any other client are answered as if the routes did not exist. IPv4 clients
+ * connected through IPv4-mapped IPv6 addresses are matched as IPv4.
+ */
+class admin_access
+{
+public:
+    /**
+     * @brief Access the shared instance.
+     *
+     * @return A reference to the process-wide instance.
+     */
+    static admin_access& instance();
+
+    /**
+     * @brief Set the allowed networks.
+     *
+     * Must be called before the I/O threads start accepting connections.
+     *
+     * @param list Comma-separated addresses and CIDR networks, e.g. "127.0.0.1,10.0.0.0/8,::1".
+     * @throws std::invalid_argument if an entry is not an address or network.
+     */
+    void configure(std::string const& list);
+
+    /**
+     * @brief Check whether a client may use the admin endpoints.
+     *
+     * @param client The client's address.
+     * @return True if it belongs to one of the allowed networks.
+     */
+    bool allowed(boost::asio::ip::address const& client) const;
+
+    admin_access(admin_access const&) = delete;
+    admin_access& operator=(admin_access const&) = delete;
+
+private:
+    admin_access() = default;
+
+    /**
+     * @brief An allowed network, with the address in network byte order.
+     */
+    struct network
+    {
+        bool v6 = false;                    ///< Whether the address is IPv6
+        std::array<unsigned char, 16> bytes{}; ///< The address, IPv4 in the first four bytes
+        unsigned prefix = 0;                ///< Number of significant leading bits
+    };
+
+    std::vector<network> networks_;         ///< The allowed networks, none until configured
+};
+
+#endif // ADMIN_ACCESS_HPP
@@ -0,0 +1,45 @@
+#ifndef BYTE_RANGE_HPP
+#define BYTE_RANGE_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief A satisfiable span of a representation, resolved against its size.
+ */
+struct byte_range
+{
+    std::uint64_t offset = 0;   ///< First byte
+    std::uint64_t size = 0;     ///< Number of bytes
+};
+
+/**
+ * @brief Outcome of evaluating a Range header.
+ */
+enum class range_result
+{
+    ignore,         ///< Not a valid bytes range set; send the full representation
+    satisfiable,    ///< At least one range can be served
+    unsatisfiable   ///< No range overlaps the representation; answer 416
+};
+
+/**
+ * @brief Parse a Range header value against a representation size.
+ *
+ * Accepts "bytes=" followed by "first-last", "first-" and "-suffix" specs. Specs that
+ * start beyond the end are dropped, and overlapping or adjacent ones are merged, so
+ * the ranges never cover a byte twice. A malformed header, or one with more than
+ * max_ranges specs, is ignored as a whole. Together, these keep ranges from being
+ * used to multiply the response size.
+ *
+ * @param header The Range header value.
+ * @param size The size of the representation.
+ * @param ranges Receives the satisfiable ranges, sorted and disjoint.
+ * @param max_ranges The largest number of specs honoured.
+ * @return How to answer the request.
+ */
+range_result parse_range(std::string_view header, std::uint64_t size, std::vector<byte_range>& ranges,
+                         std::size_t max_ranges = 16);
+
+#endif // BYTE_RANGE_HPP
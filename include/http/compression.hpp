@@ -0,0 +1,150 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include "precompressed.hpp"
+#include "../util/beast.hpp"
+#include <boost/asio/thread_pool.hpp>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @brief On-the-fly gzip/deflate compression of static files without a precompressed variant.
+ *
+ * Files up to a configurable size are compressed once, on a worker thread, and the
+ * output is memoized in a byte-bounded LRU keyed by path, modification time and coding,
+ * so a changed file simply misses. Until the output is ready, and for larger files,
+ * responses are compressed while they are sent (see deflate_body). Small files and
+ * MIME types that are already compressed are left alone. Disabled until configure()
+ * is called.
+ */
+class compression
+{
+public:
+    using buffer_type = std::shared_ptr<std::string const>;
+
+    /**
+     * @brief Access the shared compression instance.
+     *
+     * @return A reference to the process-wide instance.
+     */
+    static compression& instance();
+
+    /**
+     * @brief Enable compression.
+     *
+     * Must be called before the I/O threads start serving requests.
+     *
+     * @param min_size Files smaller than this are sent uncompressed.
+     * @param cache_capacity The maximum number of compressed bytes kept in the cache.
+     * @param max_cached_file_size Larger files are compressed while streaming instead of cached.
+     */
+    void configure(std::uint64_t min_size, std::uint64_t cache_capacity, std::uint64_t max_cached_file_size);
+
+    /**
+     * @brief Pick the coding for a response.
+     *
+     * @param accepted The codings the client accepts, from precompressed::accepted().
+     * @param content_type The Content-Type of the response, from mime_type().
+     * @return precompressed::gzip or precompressed::deflate, or 0 to send the response as is.
+     */
+    unsigned negotiate(unsigned accepted, std::string_view content_type) const;
+
+    /**
+     * @brief Check whether a response would be compressed for some client.
+     *
+     * @param content_type The Content-Type of the response.
+     * @return True if responses of this type vary by Accept-Encoding.
+     */
+    bool compressible(std::string_view content_type) const;
+
+    /**
+     * @brief Check whether a file is large enough to be worth compressing.
+     */
+    bool worth_compressing(std::uint64_t size) const
+    {
+        return size >= min_size_;
+    }
+
+    /**
+     * @brief Check whether a file is small enough to be compressed whole and cached.
+     */
+    bool cacheable(std::uint64_t size) const
+    {
+        return size <= max_cached_file_size_;
+    }
+
+    /**
+     * @brief Get the compressed contents of a file, compressing it in the background on a miss.
+     *
+     * Never blocks on the file or zlib. A miss queues the file on the worker thread,
+     * once per path, modification time and coding however many requests miss on it.
+     *
+     * @param path The path of the file.
+     * @param mtime_ns The file's modification time, in nanoseconds.
+     * @param coding The coding, gzip or deflate.
+     * @return The compressed data, or null until it is ready.
+     */
+    buffer_type get(std::string const& path, std::int64_t mtime_ns, unsigned coding);
+
+    compression(compression const&) = delete;
+    compression& operator=(compression const&) = delete;
+
+    ~compression();
+
+    /**
+     * @brief Get the Content-Encoding token of a coding.
+     */
+    static char const* token(unsigned coding)
+    {
+        return coding == precompressed::gzip ? "gzip" : "deflate";
+    }
+
+    /**
+     * @brief Get the zlib windowBits selecting the gzip or zlib wrapper for a coding.
+     */
+    static int window_bits(unsigned coding)
+    {
+        return coding == precompressed::gzip ? 15 + 16 : 15;
+    }
+
+private:
+    compression() = default;
+
+    /**
+     * @brief Cached output for one path, mtime and coding.
+     */
+    struct entry
+    {
+        buffer_type data;                       ///< Compressed contents
+        std::list<std::string>::iterator lru;   ///< Position in the recency list
+    };
+
+    static std::string key(std::string const& path, std::int64_t mtime_ns, unsigned coding);
+
+    /**
+     * @brief Read and compress a file on the worker thread, then cache the output.
+     */
+    void compress(std::string const& key, std::string const& path, std::int64_t mtime_ns, unsigned coding);
+
+    void insert(std::string const& key, buffer_type data);
+    void erase(std::unordered_map<std::string, entry>::iterator it);
+
+    bool enabled_ = false;                              ///< Whether configure() was called
+    std::uint64_t min_size_ = 0;                        ///< Smallest file that is compressed
+    std::uint64_t capacity_ = 0;                        ///< Maximum compressed bytes cached
+    std::uint64_t max_cached_file_size_ = 0;            ///< Largest file compressed whole
+    std::mutex mutex_;                                  ///< Protects the members below
+    std::uint64_t size_ = 0;                            ///< Compressed bytes currently cached
+    std::list<std::string> lru_;                        ///< Keys, most recently used first
+    std::unordered_map<std::string, entry> entries_;    ///< Cached output by key
+    std::unordered_set<std::string> pending_;           ///< Keys queued or being compressed
+    std::unique_ptr<net::thread_pool> pool_;            ///< The worker thread, null without a cache
+};
+
+#endif // COMPRESSION_HPP
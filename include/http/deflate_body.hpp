@@ -0,0 +1,195 @@
+#ifndef DEFLATE_BODY_HPP
+#define DEFLATE_BODY_HPP
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <zlib.h>
+
+namespace beast = boost::beast; // Namespace alias for Boost.Beast
+namespace http = beast::http;   // Namespace alias for Boost.Beast's HTTP module
+
+/**
+ * @brief zlib state that compresses a file region into chunks of bounded size.
+ *
+ * Input is pulled through a callable, so the same loop serves the position-based
+ * reads of deflate_body and the pread(2) calls made on the file_io threads.
+ */
+class file_deflater
+{
+public:
+    static constexpr std::size_t chunk_size = 64 * 1024;   ///< Bytes read and produced per step
+
+private:
+    std::unique_ptr<z_stream> zs_;          ///< Compressor state; zlib needs a stable address
+    std::unique_ptr<char[]> in_;            ///< Input chunk
+    std::uint64_t remaining_;               ///< File bytes not read yet
+    bool done_ = false;                     ///< Whether the stream has been finished
+
+public:
+    /**
+     * @param size Number of file bytes to compress.
+     */
+    explicit file_deflater(std::uint64_t size)
+        : remaining_(size)
+    {
+    }
+
+    ~file_deflater()
+    {
+        if(zs_)
+            deflateEnd(zs_.get());
+    }
+
+    file_deflater(file_deflater const&) = delete;
+    file_deflater& operator=(file_deflater const&) = delete;
+
+    /**
+     * @brief Set up the compressor.
+     *
+     * @param window_bits zlib windowBits: 15 + 16 for gzip, 15 for deflate.
+     * @param ec Set if zlib could not allocate its state.
+     */
+    void init(int window_bits, beast::error_code& ec)
+    {
+        auto zs = std::make_unique<z_stream>();
+        if(deflateInit2(zs.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            ec = beast::errc::make_error_code(beast::errc::not_enough_memory);
+            return;
+        }
+        zs_ = std::move(zs);
+        in_.reset(new char[chunk_size]);
+        ec = {};
+    }
+
+    /**
+     * @brief Check whether the compressed stream has been finished.
+     */
+    bool done() const
+    {
+        return done_;
+    }
+
+    /**
+     * @brief Produce the next compressed chunk.
+     *
+     * @param out Destination of chunk_size bytes.
+     * @param read Called as std::size_t(char* data, std::size_t size, error_code&) for more input.
+     * @param ec Set on a read or zlib error.
+     * @return The number of bytes produced, 0 once the stream is finished.
+     */
+    template<class Read>
+    std::size_t next(char* out, Read&& read, beast::error_code& ec)
+    {
+        ec = {};
+        if(done_)
+            return 0;
+
+        auto& zs = *zs_;
+        zs.next_out = reinterpret_cast<Bytef*>(out);
+        zs.avail_out = static_cast<uInt>(chunk_size);
+
+        // Feed input until zlib emits something or the stream ends.
+        while(zs.avail_out == chunk_size)
+        {
+            if(zs.avail_in == 0 && remaining_ > 0)
+            {
+                auto const n = read(in_.get(),
+                    static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, chunk_size)), ec);
+                if(ec)
+                    return 0;
+                if(n == 0)
+                {
+                    ec = http::error::short_read;
+                    return 0;
+                }
+                remaining_ -= n;
+                zs.next_in = reinterpret_cast<Bytef*>(in_.get());
+                zs.avail_in = static_cast<uInt>(n);
+            }
+
+            int const ret = deflate(&zs, remaining_ == 0 && zs.avail_in == 0 ? Z_FINISH : Z_NO_FLUSH);
+            if(ret == Z_STREAM_END)
+            {
+                done_ = true;
+                break;
+            }
+            if(ret != Z_OK && ret != Z_BUF_ERROR)
+            {
+                ec = beast::errc::make_error_code(beast::errc::io_error);
+                return 0;
+            }
+        }
+
+        return chunk_size - zs.avail_out;
+    }
+};
+
+/**
+ * @brief Body that compresses a file with zlib while it is being serialized.
+ *
+ * The compressed size is not known up front, so the body has no size() and the
+ * message is sent with chunked transfer encoding. Only a fixed input and output
+ * chunk are held in memory, whatever the size of the file. The chunks are read
+ * during serialization, on the I/O thread; with file_io enabled, handle_get leaves
+ * the file to the session and async_deflate_file instead.
+ */
+struct deflate_body
+{
+    static constexpr std::size_t chunk_size = file_deflater::chunk_size;   ///< Bytes read and produced per step
+
+    /**
+     * @brief The file to compress and the zlib wrapper to use.
+     */
+    struct value_type
+    {
+        beast::file file;           ///< The open file, read from its current position
+        std::uint64_t size = 0;     ///< Number of bytes to compress
+        int window_bits = 15 + 16;  ///< zlib windowBits: 15 + 16 for gzip, 15 for deflate
+    };
+
+    /**
+     * @brief Serializer algorithm, yields one compressed chunk per step.
+     */
+    class writer
+    {
+        value_type& body_;                      ///< The body being serialized
+        file_deflater deflater_;                ///< Compressor state and input chunk
+        std::unique_ptr<char[]> out_;           ///< Output chunk
+
+    public:
+        using const_buffers_type = boost::asio::const_buffer;
+
+        template<bool isRequest, class Fields>
+        writer(http::header<isRequest, Fields> const&, value_type& body)
+            : body_(body)
+            , deflater_(body.size)
+        {
+        }
+
+        void init(beast::error_code& ec)
+        {
+            deflater_.init(body_.window_bits, ec);
+            if(! ec)
+                out_.reset(new char[chunk_size]);
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec)
+        {
+            auto const produced = deflater_.next(out_.get(),
+                [this](char* data, std::size_t size, beast::error_code& ec)
+                {
+                    return body_.file.read(data, size, ec);
+                }, ec);
+            if(ec || produced == 0)
+                return boost::none;
+            return {{const_buffers_type(out_.get(), produced), ! deflater_.done()}};
+        }
+    };
+};
+
+#endif // DEFLATE_BODY_HPP
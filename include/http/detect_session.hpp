@@ -4,6 +4,7 @@
 #include "http_session.hpp"
 #include "ssl_http_session.hpp"
 #include "plain_http_session.hpp"
+#include "../util/metrics.hpp"
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
@@ -18,21 +19,22 @@
 class detect_session : public std::enable_shared_from_this<detect_session>
 {
     beast::tcp_stream stream_;                  ///< The underlying TCP stream for the session.
-    ssl::context& ctx_;                         ///< The SSL context, used for configuring SSL sessions.
+    std::shared_ptr<ssl::context> ctx_;         ///< The SSL context, used for configuring SSL sessions.
     std::shared_ptr<std::string const> doc_root_; ///< The root directory for serving HTTP content.
     beast::flat_buffer buffer_;                 ///< Buffer for reading data from the stream.
+    std::chrono::steady_clock::time_point accepted_ = std::chrono::steady_clock::now(); ///< When the connection was accepted.
 
     public:
     /**
      * @brief Constructor for the detect_session class.
      * 
      * @param socket The TCP socket associated with the incoming connection.
-     * @param ctx The SSL context, passed by reference.
+     * @param ctx The SSL context current when the connection was accepted.
      * @param doc_root A shared pointer to the root directory for serving HTTP content.
      */
-    detect_session(tcp::socket&& socket, ssl::context& ctx, std::shared_ptr<std::string const> const& doc_root)
+    detect_session(tcp::socket&& socket, std::shared_ptr<ssl::context> ctx, std::shared_ptr<std::string const> const& doc_root)
         : stream_(std::move(socket))  ///< Move the socket into the TCP stream.
-          , ctx_(ctx)                   ///< Initialize the SSL context reference.
+          , ctx_(std::move(ctx))        ///< Keep the SSL context alive.
           , doc_root_(doc_root)         ///< Initialize the document root shared pointer.
     {
     }
@@ -88,12 +90,15 @@ class detect_session : public std::enable_shared_from_this<detect_session>
         if(ec)
             return fail(ec, "detect");
 
+        metrics::record(metrics::accept_to_detect, std::chrono::steady_clock::now() - accepted_);
+        metrics::add(result ? metrics::tls_detected : metrics::plain_detected);
+
         if(result)
         {
             // Launch an SSL session if SSL was detected.
             std::make_shared<ssl_http_session>(
                     std::move(stream_),
-                    ctx_,
+                    std::move(ctx_),
                     std::move(buffer_),
                     doc_root_)->run(); // Pass doc_root_ here
             return;
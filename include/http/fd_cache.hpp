@@ -0,0 +1,150 @@
+#ifndef FD_CACHE_HPP
+#define FD_CACHE_HPP
+
+#include "../util/beast.hpp"
+#include "mmap_body.hpp"
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Bounded cache of open static files and their stat data, shared by all I/O threads.
+ *
+ * A hit saves the open(2) and fstat(2) of a request. Cached descriptors are shared,
+ * so they must only be read at explicit offsets (pread(2), sendfile(2)), never
+ * through the file position. An evicted file stays open until the last response
+ * using it completes. Entries are invalidated through file_watcher; without
+ * inotify they are reopened once their time to live has passed. Files within the
+ * configured size bounds are also mapped once and the mapping is shared by every
+ * response. The cache is disabled until configure() is called with a non-zero capacity.
+ */
+class fd_cache
+{
+public:
+    /**
+     * @brief An open regular file and what fstat reported when it was opened.
+     */
+    struct entry
+    {
+        std::shared_ptr<beast::file> file;  ///< The open file
+        std::uint64_t size = 0;             ///< Size of the file
+        std::int64_t mtime_ns = 0;          ///< Modification time, in nanoseconds since the epoch
+
+        /**
+         * @brief Get the mapping of the file, mapping it on first use.
+         *
+         * @return The mapping shared by every response for this version of the file,
+         *         or null if it could not be mapped.
+         */
+        std::shared_ptr<mapped_file const> mapping() const
+        {
+            std::call_once(map_once_, [this] { map_ = mapped_file::map(file->native_handle(), size); });
+            return map_;
+        }
+
+    private:
+        mutable std::once_flag map_once_;                   ///< Guards the creation of map_
+        mutable std::shared_ptr<mapped_file const> map_;    ///< The mapping, once created
+    };
+
+    using entry_type = std::shared_ptr<entry const>;
+
+    /**
+     * @brief Access the shared cache instance.
+     *
+     * @return A reference to the process-wide cache.
+     */
+    static fd_cache& instance();
+
+    /**
+     * @brief Enable the cache.
+     *
+     * Must be called before the I/O threads start serving requests.
+     *
+     * @param capacity The maximum number of open files held, 0 to disable the cache.
+     * @param ttl How long an entry is trusted when inotify is not available.
+     * @param map_min_size The smallest file served from a mapping.
+     * @param map_max_size The largest file served from a mapping, 0 to never map files.
+     */
+    void configure(std::size_t capacity, std::chrono::milliseconds ttl,
+                   std::uint64_t map_min_size, std::uint64_t map_max_size);
+
+    /**
+     * @brief Check whether the cache is enabled.
+     *
+     * @return True if configure() was called with a non-zero capacity.
+     */
+    bool enabled() const
+    {
+        return capacity_ != 0;
+    }
+
+    /**
+     * @brief Check whether a cached file of this size is served from its mapping.
+     *
+     * @param size The size of the file.
+     * @return True if the size is within the configured bounds.
+     */
+    bool mappable(std::uint64_t size) const
+    {
+        return size >= map_min_size_ && size <= map_max_size_ && size != 0;
+    }
+
+    /**
+     * @brief Get an open file, opening it on a miss.
+     *
+     * @param path The path of the file.
+     * @return The open file, or null if the cache is disabled or the path is not a
+     *         regular file, in which case the caller opens it itself.
+     */
+    entry_type get(std::string const& path);
+
+    /**
+     * @brief Drop a cached file.
+     *
+     * @param path The path of the file, or an empty string to drop every entry.
+     */
+    void invalidate(std::string const& path);
+
+private:
+    fd_cache() = default;
+
+    /**
+     * @brief A cached file and its bookkeeping.
+     */
+    struct slot
+    {
+        entry_type value;                                   ///< The open file
+        std::chrono::steady_clock::time_point expires;      ///< When the entry is reopened without inotify
+        std::list<std::string>::iterator lru;               ///< Position in the recency list
+    };
+
+    /**
+     * @brief Open a file and stat it.
+     *
+     * @param path The path of the file.
+     * @return The open file, or null if it cannot be opened or is not a regular file.
+     */
+    static entry_type open(std::string const& path);
+
+    /**
+     * @brief Remove an entry. Must be called with mutex_ held.
+     */
+    void erase(std::unordered_map<std::string, slot>::iterator it);
+
+    std::size_t capacity_ = 0;                          ///< Maximum open files, 0 when disabled
+    std::chrono::milliseconds ttl_{0};                  ///< Lifetime of entries without inotify
+    std::uint64_t map_min_size_ = 0;                    ///< Smallest mapped file
+    std::uint64_t map_max_size_ = 0;                    ///< Largest mapped file, 0 when mapping is off
+    bool watched_ = false;                              ///< Whether invalidation comes from inotify
+    std::uint64_t generation_ = 0;                      ///< Bumped on every invalidation
+    std::mutex mutex_;                                  ///< Protects the members below
+    std::unordered_map<std::string, slot> entries_;     ///< Open files by path
+    std::list<std::string> lru_;                        ///< Paths, most recently used first
+};
+
+#endif // FD_CACHE_HPP
@@ -0,0 +1,126 @@
+#ifndef FILE_CACHE_HPP
+#define FILE_CACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @brief Size-bounded in-memory cache of static files, shared by all I/O threads.
+ * 
+ * File contents are held in immutable shared buffers so a cache hit can be sent
+ * without copying, and the buffer stays valid for in-flight responses even after
+ * the entry is evicted. Entries are invalidated through file_watcher when the file
+ * on disk changes. When file_io is enabled, misses are loaded on its threads while
+ * the response that missed is served from disk. The cache is disabled until
+ * configure() is called with a non-zero capacity.
+ */
+class file_cache
+{
+public:
+    using buffer_type = std::shared_ptr<std::string const>;
+
+    /**
+     * @brief Access the shared cache instance.
+     * 
+     * @return A reference to the process-wide cache.
+     */
+    static file_cache& instance();
+
+    /**
+     * @brief Enable the cache.
+     * 
+     * Must be called before the I/O threads start serving requests.
+     * 
+     * @param capacity The maximum number of content bytes held by the cache, 0 to disable it.
+     * @param max_file_size The largest file that will be cached.
+     */
+    void configure(std::uint64_t capacity, std::uint64_t max_file_size);
+
+    /**
+     * @brief Check whether the cache is enabled.
+     * 
+     * @return True if configure() was called with a non-zero capacity.
+     */
+    bool enabled() const
+    {
+        return capacity_ != 0;
+    }
+
+    /**
+     * @brief Get the contents of a file, loading it into the cache on a miss.
+     * 
+     * @param path The path of the file.
+     * @return The file contents, or null if the file cannot be cached (disabled,
+     *         missing, not a regular file or too large) or is still being loaded,
+     *         and must be served from disk.
+     */
+    buffer_type get(std::string const& path);
+
+    /**
+     * @brief Drop a cached file.
+     * 
+     * @param path The path of the file, or an empty string to drop every entry.
+     */
+    void invalidate(std::string const& path);
+
+private:
+    file_cache() = default;
+
+    /**
+     * @brief Cached state of a single path.
+     * 
+     * Files that are too large are remembered with a null buffer so that they do not
+     * cost an open/fstat on every request just to be rejected again.
+     */
+    struct entry
+    {
+        buffer_type data;                           ///< File contents, null if the file is too large
+        std::list<std::string>::iterator lru;       ///< Position in the recency list
+    };
+
+    /**
+     * @brief Read a file into a new buffer.
+     * 
+     * @param path The path of the file.
+     * @param too_large Set to true if the file exceeds the per-file limit.
+     * @return The file contents, or null if the file could not be read or is too large.
+     */
+    buffer_type load(std::string const& path, bool& too_large) const;
+
+    /**
+     * @brief Load a file and insert it unless it changed in the meantime.
+     * 
+     * @param path The path of the file.
+     * @param generation The generation observed before the file was watched.
+     * @return The file contents, or null if the file cannot be cached.
+     */
+    buffer_type fill(std::string const& path, std::uint64_t generation);
+
+    /**
+     * @brief Insert an entry and evict the least recently used ones over capacity.
+     * 
+     * Must be called with mutex_ held.
+     */
+    void insert(std::string const& path, buffer_type data);
+
+    /**
+     * @brief Remove an entry. Must be called with mutex_ held.
+     */
+    void erase(std::unordered_map<std::string, entry>::iterator it);
+
+    std::uint64_t capacity_ = 0;                        ///< Maximum cached content bytes, 0 when disabled
+    std::uint64_t max_file_size_ = 0;                   ///< Largest cacheable file
+    std::uint64_t size_ = 0;                            ///< Current cached content bytes
+    std::uint64_t generation_ = 0;                      ///< Bumped on every invalidation
+    std::mutex mutex_;                                  ///< Protects the members below
+    std::unordered_map<std::string, entry> entries_;    ///< Cached files by path
+    std::list<std::string> lru_;                        ///< Paths, most recently used first
+    std::unordered_set<std::string> loading_;           ///< Paths being loaded on the file_io threads
+};
+
+#endif // FILE_CACHE_HPP
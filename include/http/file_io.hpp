@@ -0,0 +1,516 @@
+#ifndef FILE_IO_HPP
+#define FILE_IO_HPP
+
+#include "../util/beast.hpp"
+#include "sendfile.hpp"
+#include "deflate_body.hpp"
+#include "file_ranges_body.hpp"
+#include <boost/asio/thread_pool.hpp>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+/**
+ * @brief Process-wide backend that performs blocking file reads off the I/O threads.
+ *
+ * Reads run on a small dedicated thread pool and complete on the caller's
+ * executor, so a cold file on slow storage delays only the response that needs
+ * it while the io_context keeps serving every other connection. The backend is
+ * disabled until configure() is called with a non-zero thread count.
+ *
+ * With the backend enabled, sessions run the request handler here, so the
+ * open(2) and stat(2) calls of cache misses stay off the I/O threads as well.
+ * Every file body that is not served from memory is then left to the session
+ * and read here: whole files, single and multipart ranges, and large files
+ * compressed while streaming. Memoized compression runs on its own worker.
+ */
+class file_io
+{
+public:
+    /**
+     * @brief Access the shared backend instance.
+     *
+     * @return A reference to the process-wide backend.
+     */
+    static file_io& instance();
+
+    /**
+     * @brief Start the reader threads.
+     *
+     * Must be called before the I/O threads start serving requests.
+     *
+     * @param threads The number of reader threads, 0 to keep reads on the I/O threads.
+     */
+    void configure(std::size_t threads);
+
+    /**
+     * @brief Check whether reads are performed asynchronously.
+     *
+     * @return True if configure() was called with a non-zero thread count.
+     */
+    bool enabled() const
+    {
+        return pool_ != nullptr;
+    }
+
+    /**
+     * @brief Read from a file at an offset on a reader thread.
+     *
+     * @param file The file, kept open until the read completes.
+     * @param offset The offset of the first byte to read.
+     * @param data The destination, which must stay valid until the handler runs.
+     * @param size The number of bytes to read at most.
+     * @param executor The executor the handler is posted to.
+     * @param handler Called as void(error_code, std::size_t bytes_read); 0 bytes means end of file.
+     */
+    template<class Executor, class Handler>
+    void async_read_at(
+        std::shared_ptr<beast::file> file,
+        std::uint64_t offset,
+        char* data,
+        std::size_t size,
+        Executor executor,
+        Handler&& handler)
+    {
+        net::post(*pool_,
+            [file = std::move(file), offset, data, size, executor, handler = std::forward<Handler>(handler)]() mutable
+            {
+                beast::error_code ec;
+                ssize_t n;
+                do
+                    n = ::pread(file->native_handle(), data, size, static_cast<off_t>(offset));
+                while(n < 0 && errno == EINTR);
+
+                if(n < 0)
+                    ec = beast::error_code(errno, beast::system_category());
+                net::post(executor, beast::bind_front_handler(std::move(handler), ec, n < 0 ? 0 : static_cast<std::size_t>(n)));
+            });
+    }
+
+    /**
+     * @brief Run a blocking task on a reader thread.
+     *
+     * @param task Called as void() on a reader thread.
+     */
+    template<class Task>
+    void post(Task&& task)
+    {
+        net::post(*pool_, std::forward<Task>(task));
+    }
+
+    file_io(file_io const&) = delete;
+    file_io& operator=(file_io const&) = delete;
+
+    ~file_io();
+
+private:
+    file_io() = default;
+
+    std::unique_ptr<net::thread_pool> pool_;    ///< The reader threads, null when disabled
+};
+
+/**
+ * @brief State of file spans copied to a stream through the file_io backend.
+ *
+ * Two buffers are used so that the next chunk is read from disk while the previous
+ * one is written to the stream. The literal text of a file_ranges_body (multipart
+ * boundaries and part headers) goes out in the same write as the chunk that follows
+ * it. Works on any stream, including TLS ones that cannot use sendfile(2).
+ *
+ * @tparam Stream The destination stream type.
+ * @tparam Handler The completion handler, called as void(error_code, std::size_t).
+ */
+template<class Stream, class Handler>
+class file_copy_op : public std::enable_shared_from_this<file_copy_op<Stream, Handler>>
+{
+public:
+    static constexpr std::size_t chunk_size = 64 * 1024;   ///< Bytes read and written per step
+
+private:
+    Stream& stream_;                                ///< The destination stream
+    file_ranges_body::value_type body_;             ///< The spans and text to send
+    std::size_t part_ = 0;                          ///< Part being read, parts.size() once all are read
+    std::uint64_t sent_ = 0;                        ///< Bytes of the current span already read
+    std::chrono::steady_clock::duration timeout_;   ///< Maximum duration of each write
+    Handler handler_;                               ///< The completion handler
+    std::unique_ptr<char[]> buffers_;               ///< Two chunks, one being read and one being written
+    char* reading_;                                 ///< The chunk being filled
+    char* writing_;                                 ///< The chunk being sent
+    std::string reading_text_;                      ///< Text sent before the chunk being filled
+    std::string writing_text_;                      ///< Text sent before the chunk being sent
+    std::size_t read_ = 0;                          ///< Bytes in the chunk being filled
+    std::size_t total_ = 0;                         ///< Bytes written so far
+    int pending_ = 0;                               ///< Outstanding read and write operations
+    beast::error_code ec_;                          ///< First error of the current step
+
+public:
+    file_copy_op(Stream& stream, file_ranges_body::value_type body, std::chrono::steady_clock::duration timeout, Handler handler)
+        : stream_(stream)
+        , body_(std::move(body))
+        , timeout_(timeout)
+        , handler_(std::move(handler))
+        , buffers_(new char[2 * chunk_size])
+        , reading_(buffers_.get())
+        , writing_(buffers_.get() + chunk_size)
+    {
+    }
+
+    /**
+     * @brief Read the first chunk.
+     */
+    void start()
+    {
+        reading_text_ = body_.parts.empty() ? body_.suffix : body_.parts.front().prefix;
+        pending_ = 1;
+        read();
+    }
+
+private:
+    /**
+     * @brief Read the next chunk into the reading buffer, if any is left.
+     *
+     * Moving past a span queues the text that follows it: the prefix of the next
+     * part, or the suffix after the last one.
+     */
+    void read()
+    {
+        while(part_ < body_.parts.size() && sent_ == body_.parts[part_].size)
+        {
+            sent_ = 0;
+            reading_text_ += ++part_ < body_.parts.size() ? body_.parts[part_].prefix : body_.suffix;
+        }
+
+        if(part_ == body_.parts.size())
+        {
+            read_ = 0;
+            return join();
+        }
+
+        auto self = this->shared_from_this();
+        auto const& p = body_.parts[part_];
+        auto const n = static_cast<std::size_t>(std::min<std::uint64_t>(p.size - sent_, chunk_size));
+        file_io::instance().async_read_at(body_.file, p.offset + sent_, reading_, n, stream_.get_executor(),
+            [self](beast::error_code ec, std::size_t bytes)
+            {
+                if(! ec && bytes == 0)
+                    ec = net::error::eof; // File was truncated underneath us
+                self->sent_ += bytes;
+                self->read_ = bytes;
+                self->done(ec);
+            });
+    }
+
+    /**
+     * @brief Record the completion of a read or write; the last one starts the next step.
+     */
+    void done(beast::error_code ec)
+    {
+        if(ec && ! ec_)
+            ec_ = ec;
+        join();
+    }
+
+    /**
+     * @brief Start the next step once the chunk is read and the previous one written.
+     */
+    void join()
+    {
+        if(--pending_ > 0)
+            return;
+        if(ec_)
+            return complete(ec_);
+        if(read_ == 0 && reading_text_.empty())
+            return complete({});
+
+        // Write the chunk just read, after its text, while the following one is read.
+        std::swap(reading_, writing_);
+        std::swap(reading_text_, writing_text_);
+        reading_text_.clear();
+        auto const n = read_;
+        pending_ = n ? 2 : 1;
+
+        auto self = this->shared_from_this();
+        std::array<net::const_buffer, 2> const buffers{
+            net::buffer(writing_text_), net::buffer(writing_, n)};
+        beast::get_lowest_layer(stream_).expires_after(timeout_);
+        net::async_write(stream_, buffers,
+            [self](beast::error_code ec, std::size_t bytes)
+            {
+                self->total_ += bytes;
+                self->done(ec);
+            });
+
+        // Nothing is left to read once only the closing text was.
+        if(n)
+            read();
+    }
+
+    /**
+     * @brief Invoke the completion handler with the result of the transfer.
+     */
+    void complete(beast::error_code ec)
+    {
+        beast::get_lowest_layer(stream_).expires_never();
+        net::post(
+            stream_.get_executor(),
+            beast::bind_front_handler(std::move(handler_), ec, total_));
+    }
+};
+
+/**
+ * @brief Asynchronously copy a file region to a stream, reading it on the file_io threads.
+ *
+ * Only valid while file_io::instance().enabled() is true.
+ *
+ * @param stream The destination stream.
+ * @param file The file region to send.
+ * @param timeout Maximum duration of each chunk write.
+ * @param handler Called as void(error_code, std::size_t bytes_transferred).
+ */
+template<class Stream, class Handler>
+void async_copy_file(
+    Stream& stream,
+    file_payload file,
+    std::chrono::steady_clock::duration timeout,
+    Handler&& handler)
+{
+    file_ranges_body::value_type body;
+    body.file = std::move(file.file);
+    body.parts.push_back({{}, file.offset, file.size});
+    async_copy_file(stream, std::move(body), timeout, std::forward<Handler>(handler));
+}
+
+/**
+ * @brief Asynchronously copy file spans and their text to a stream, reading them on the file_io threads.
+ *
+ * Only valid while file_io::instance().enabled() is true.
+ *
+ * @param stream The destination stream.
+ * @param body The spans to send, as a file_ranges_body would serialize them.
+ * @param timeout Maximum duration of each chunk write.
+ * @param handler Called as void(error_code, std::size_t bytes_transferred).
+ */
+template<class Stream, class Handler>
+void async_copy_file(
+    Stream& stream,
+    file_ranges_body::value_type body,
+    std::chrono::steady_clock::duration timeout,
+    Handler&& handler)
+{
+    std::make_shared<file_copy_op<Stream, std::decay_t<Handler>>>(
+        stream, std::move(body), timeout, std::forward<Handler>(handler))->start();
+}
+
+/**
+ * @brief Fields of a chunked response whose chunks are written by async_deflate_file.
+ *
+ * The header says Transfer-Encoding: chunked, but Beast must treat the message as
+ * not chunked; otherwise it would follow the header with the last chunk of an
+ * empty body.
+ */
+class chunked_header_fields : public http::fields
+{
+protected:
+    bool get_chunked_impl() const noexcept
+    {
+        return false;
+    }
+};
+
+/**
+ * @brief State of a file compressed into HTTP chunks through the file_io backend.
+ *
+ * Each chunk is read and compressed on a reader thread, so neither disk latency nor
+ * zlib holds up the I/O thread. As in file_copy_op, the next chunk is produced while
+ * the previous one is written.
+ *
+ * @tparam Stream The destination stream type.
+ * @tparam Handler The completion handler, called as void(error_code, std::size_t).
+ */
+template<class Stream, class Handler>
+class file_deflate_op : public std::enable_shared_from_this<file_deflate_op<Stream, Handler>>
+{
+    static constexpr std::size_t chunk_size = file_deflater::chunk_size;
+
+    Stream& stream_;                                ///< The destination stream
+    file_payload file_;                             ///< The region left to read
+    file_deflater deflater_;                        ///< Compressor, used by one reader thread at a time
+    std::chrono::steady_clock::duration timeout_;   ///< Maximum duration of each write
+    Handler handler_;                               ///< The completion handler
+    std::unique_ptr<char[]> buffers_;               ///< Two chunks, one being produced and one being written
+    char* reading_;                                 ///< The chunk being produced
+    char* writing_;                                 ///< The chunk being sent
+    char size_line_[20];                            ///< Size line of the chunk being sent
+    std::size_t read_ = 0;                          ///< Bytes in the chunk being produced
+    bool last_ = false;                             ///< Whether the chunk being produced ends the stream
+    bool terminated_ = false;                       ///< Whether the last chunk has been written
+    std::size_t total_ = 0;                         ///< Bytes written so far
+    int pending_ = 0;                               ///< Outstanding produce and write operations
+    beast::error_code ec_;                          ///< First error of the current step
+
+public:
+    file_deflate_op(Stream& stream, file_payload file, int window_bits, std::chrono::steady_clock::duration timeout, Handler handler)
+        : stream_(stream)
+        , file_(std::move(file))
+        , deflater_(file_.size)
+        , timeout_(timeout)
+        , handler_(std::move(handler))
+        , buffers_(new char[2 * chunk_size])
+        , reading_(buffers_.get())
+        , writing_(buffers_.get() + chunk_size)
+    {
+        deflater_.init(window_bits, ec_);
+    }
+
+    /**
+     * @brief Produce the first chunk.
+     */
+    void start()
+    {
+        if(ec_)
+            return complete(ec_);
+        pending_ = 1;
+        produce();
+    }
+
+private:
+    /**
+     * @brief Read and compress the next chunk on a reader thread.
+     */
+    void produce()
+    {
+        auto self = this->shared_from_this();
+        file_io::instance().post(
+            [self]
+            {
+                beast::error_code ec;
+                auto const n = self->deflater_.next(self->reading_,
+                    [&self](char* data, std::size_t size, beast::error_code& ec) -> std::size_t
+                    {
+                        ssize_t got;
+                        do
+                            got = ::pread(self->file_.file->native_handle(), data, size, static_cast<off_t>(self->file_.offset));
+                        while(got < 0 && errno == EINTR);
+                        if(got < 0)
+                        {
+                            ec = beast::error_code(errno, beast::system_category());
+                            return 0;
+                        }
+                        self->file_.offset += static_cast<std::uint64_t>(got);
+                        return static_cast<std::size_t>(got);
+                    }, ec);
+                bool const last = self->deflater_.done();
+                net::post(self->stream_.get_executor(),
+                    [self, ec, n, last]
+                    {
+                        self->read_ = n;
+                        self->last_ = last;
+                        self->done(ec);
+                    });
+            });
+    }
+
+    /**
+     * @brief Record the completion of a produce or write; the last one starts the next step.
+     */
+    void done(beast::error_code ec)
+    {
+        if(ec && ! ec_)
+            ec_ = ec;
+        join();
+    }
+
+    /**
+     * @brief Write the chunk just produced while the following one is produced.
+     *
+     * The last chunk carries the terminating zero-size chunk; if zlib finished
+     * without output, the terminator is written on its own.
+     */
+    void join()
+    {
+        if(--pending_ > 0)
+            return;
+        if(ec_)
+            return complete(ec_);
+
+        auto self = this->shared_from_this();
+        auto const written = [self](beast::error_code ec, std::size_t bytes)
+        {
+            self->total_ += bytes;
+            self->done(ec);
+        };
+
+        beast::get_lowest_layer(stream_).expires_after(timeout_);
+        if(read_ == 0)
+        {
+            if(terminated_)
+                return complete({});
+            terminated_ = true;
+            pending_ = 1;
+            return net::async_write(stream_, net::buffer("0\r\n\r\n", 5), written);
+        }
+
+        std::swap(reading_, writing_);
+        auto const n = read_;
+        auto const size_line = std::snprintf(size_line_, sizeof(size_line_), "%zx\r\n", n);
+        terminated_ = last_;
+        std::array<net::const_buffer, 3> const buffers{
+            net::buffer(size_line_, static_cast<std::size_t>(size_line)),
+            net::buffer(writing_, n),
+            last_ ? net::buffer("\r\n0\r\n\r\n", 7) : net::buffer("\r\n", 2)};
+
+        if(last_)
+        {
+            read_ = 0;
+            pending_ = 1;
+            return net::async_write(stream_, buffers, written);
+        }
+
+        pending_ = 2;
+        net::async_write(stream_, buffers, written);
+        produce();
+    }
+
+    /**
+     * @brief Invoke the completion handler with the result of the transfer.
+     */
+    void complete(beast::error_code ec)
+    {
+        beast::get_lowest_layer(stream_).expires_never();
+        net::post(
+            stream_.get_executor(),
+            beast::bind_front_handler(std::move(handler_), ec, total_));
+    }
+};
+
+/**
+ * @brief Asynchronously send a file as gzip or deflate chunks, reading and compressing it on the file_io threads.
+ *
+ * The response header must use chunked_header_fields. Only valid while
+ * file_io::instance().enabled() is true.
+ *
+ * @param stream The destination stream.
+ * @param file The file region to compress, read at explicit offsets.
+ * @param window_bits zlib windowBits: 15 + 16 for gzip, 15 for deflate.
+ * @param timeout Maximum duration of each chunk write.
+ * @param handler Called as void(error_code, std::size_t bytes_transferred).
+ */
+template<class Stream, class Handler>
+void async_deflate_file(
+    Stream& stream,
+    file_payload file,
+    int window_bits,
+    std::chrono::steady_clock::duration timeout,
+    Handler&& handler)
+{
+    std::make_shared<file_deflate_op<Stream, std::decay_t<Handler>>>(
+        stream, std::move(file), window_bits, timeout, std::forward<Handler>(handler))->start();
+}
+
+#endif // FILE_IO_HPP
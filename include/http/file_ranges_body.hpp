@@ -0,0 +1,138 @@
+#ifndef FILE_RANGES_BODY_HPP
+#define FILE_RANGES_BODY_HPP
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace beast = boost::beast; // Namespace alias for Boost.Beast
+namespace http = beast::http;   // Namespace alias for Boost.Beast's HTTP module
+
+/**
+ * @brief Body made of spans of one file, each optionally preceded by literal text.
+ *
+ * Serves a whole file or a single byte range (one part, no text), or a
+ * multipart/byteranges payload (one part per range, each prefixed with its boundary
+ * and part headers, followed by the closing boundary). File data is read with
+ * pread(2), so the file position is never touched and the file may be shared.
+ * Reads happen during serialization, on the I/O thread; with file_io enabled,
+ * handle_get leaves the spans to the session and async_copy_file instead.
+ */
+struct file_ranges_body
+{
+    static constexpr std::size_t chunk_size = 64 * 1024;   ///< Largest file read per step
+
+    /**
+     * @brief Text followed by a span of the file.
+     */
+    struct part
+    {
+        std::string prefix;         ///< Literal bytes sent before the span
+        std::uint64_t offset = 0;   ///< First byte of the span
+        std::uint64_t size = 0;     ///< Length of the span
+    };
+
+    /**
+     * @brief The file, its spans and the literal bytes sent after the last one.
+     */
+    struct value_type
+    {
+        std::shared_ptr<beast::file> file;  ///< The open file
+        std::vector<part> parts;            ///< Spans in send order
+        std::string suffix;                 ///< Literal bytes sent after the last span
+    };
+
+    /**
+     * @brief Returns the payload size of the body.
+     */
+    static std::uint64_t size(value_type const& body)
+    {
+        std::uint64_t n = body.suffix.size();
+        for(auto const& p : body.parts)
+            n += p.prefix.size() + p.size;
+        return n;
+    }
+
+    /**
+     * @brief Serializer algorithm, alternating between literal text and file chunks.
+     */
+    class writer
+    {
+        value_type const& body_;            ///< The body being serialized
+        std::size_t part_ = 0;              ///< Current part, parts.size() for the suffix
+        bool in_span_ = false;              ///< Whether the prefix of the current part was sent
+        std::uint64_t sent_ = 0;            ///< Bytes of the current span already sent
+        std::unique_ptr<char[]> buf_;       ///< File read buffer
+
+    public:
+        using const_buffers_type = boost::asio::const_buffer;
+
+        template<bool isRequest, class Fields>
+        writer(http::header<isRequest, Fields> const&, value_type const& body)
+            : body_(body)
+        {
+        }
+
+        void init(beast::error_code& ec)
+        {
+            buf_.reset(new char[chunk_size]);
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec)
+        {
+            ec = {};
+            while(part_ < body_.parts.size())
+            {
+                auto const& p = body_.parts[part_];
+
+                if(! in_span_)
+                {
+                    in_span_ = true;
+                    if(! p.prefix.empty())
+                        return {{const_buffers_type(p.prefix.data(), p.prefix.size()), true}};
+                }
+
+                if(sent_ < p.size)
+                {
+                    auto const want = static_cast<std::size_t>(std::min<std::uint64_t>(p.size - sent_, chunk_size));
+                    auto const n = ::pread(body_.file->native_handle(), buf_.get(), want,
+                                           static_cast<off_t>(p.offset + sent_));
+                    if(n < 0)
+                    {
+                        ec = beast::error_code(errno, beast::system_category());
+                        return boost::none;
+                    }
+                    if(n == 0)
+                    {
+                        ec = http::error::short_read;
+                        return boost::none;
+                    }
+                    sent_ += static_cast<std::uint64_t>(n);
+                    bool const more = sent_ < p.size || part_ + 1 < body_.parts.size() || ! body_.suffix.empty();
+                    return {{const_buffers_type(buf_.get(), static_cast<std::size_t>(n)), more}};
+                }
+
+                ++part_;
+                in_span_ = false;
+                sent_ = 0;
+            }
+
+            if(part_ == body_.parts.size() && ! body_.suffix.empty())
+            {
+                ++part_;
+                return {{const_buffers_type(body_.suffix.data(), body_.suffix.size()), false}};
+            }
+            return boost::none;
+        }
+    };
+};
+
+#endif // FILE_RANGES_BODY_HPP
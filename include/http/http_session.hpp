@@ -3,6 +3,9 @@
 
 #include "../util/util.hpp"
 #include "request_handler.hpp"
+#include "access_log.hpp"
+#include "file_io.hpp"
+#include "../util/metrics.hpp"
 #include "../websocket/websocket_factory.hpp"
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -38,8 +41,32 @@ class http_session
         return static_cast<Derived&>(*this);
     }
 
+    /**
+     * @brief A queued response: the serialized message plus an optional file body
+     *        that the session sends after it.
+     */
+    struct pending_response
+    {
+        http::message_generator message;    ///< The response header (and body, if not deferred).
+        file_payload file;                  ///< File body left for the session to transmit.
+        int window_bits = 0;                ///< zlib windowBits if file is sent compressed in chunks.
+        file_ranges_body::value_type ranges; ///< Multipart body left for the session to transmit.
+        access_entry access;                ///< Access log entry, completed when the write finishes.
+        std::size_t header_bytes = 0;       ///< Bytes written before the deferred file body.
+        std::chrono::steady_clock::time_point request_start; ///< When the request started to arrive.
+        std::chrono::steady_clock::time_point write_start; ///< When writing this response began.
+    };
+
     static constexpr std::size_t queue_limit = 8; ///< Maximum number of responses in the queue.
-    std::queue<http::message_generator> response_queue_; ///< Queue to manage outgoing responses.
+    std::queue<pending_response> response_queue_; ///< Queue to manage outgoing responses.
+
+    /**
+     * @brief Backs the header fields and body of the request being parsed.
+     * 
+     * Reset before each request, so steady-state keep-alive traffic does not touch
+     * the heap for requests. Declared before parser_ so it outlives it.
+     */
+    arena arena_;
 
     /**
      * @brief Parser for the incoming HTTP request.
@@ -47,11 +74,49 @@ class http_session
      * The parser is stored in an optional container so that it can be constructed
      * anew for each incoming message, ensuring a clean state for each request.
      */
-    boost::optional<http::request_parser<http::string_body>> parser_;
+    boost::optional<http::request_parser<request_body, arena_allocator<char>>> parser_;
+
+    std::chrono::steady_clock::time_point parse_start_; ///< When the first bytes of the request were available.
+    std::chrono::steady_clock::time_point created_ = std::chrono::steady_clock::now(); ///< When the protocol was detected, cleared after the first request starts.
+    boost::optional<net::ip::address> remote_; ///< Address of the client, looked up by the first request.
+
+    /**
+     * @brief Get the client's address, asking the socket only once per connection.
+     * 
+     * @return The address, or the unspecified address if the socket no longer knows it.
+     */
+    net::ip::address const& remote()
+    {
+        if(! remote_)
+        {
+            beast::error_code ec;
+            auto const endpoint = beast::get_lowest_layer(derived().stream()).socket().remote_endpoint(ec);
+            remote_ = ec ? net::ip::address() : endpoint.address();
+        }
+        return *remote_;
+    }
 
     protected:
     beast::flat_buffer buffer_; ///< Buffer for reading data from the stream.
 
+    /**
+     * @brief Copy a request out of the arena onto the heap.
+     * 
+     * @param req The arena-backed request.
+     * @return An equivalent request using the default allocator.
+     */
+    static http::request<http::string_body> detach(arena_request&& req)
+    {
+        http::request<http::string_body> copy;
+        copy.method_string(req.method_string());
+        copy.target(req.target());
+        copy.version(req.version());
+        for(auto const& field : req)
+            copy.insert(field.name_string(), field.value());
+        copy.body().assign(req.body().data(), req.body().size());
+        return copy;
+    }
+
     public:
     /**
      * @brief Constructor for the http_session class.
@@ -65,6 +130,16 @@ class http_session
         : doc_root_(doc_root)
           , buffer_(std::move(buffer))
     {
+        metrics::add(metrics::http_sessions);
+    }
+
+    /**
+     * @brief Destructor, releasing the session and any unsent responses from the gauges.
+     */
+    ~http_session()
+    {
+        metrics::add(metrics::http_sessions, -1);
+        metrics::add(metrics::queued_responses, -static_cast<std::int64_t>(response_queue_.size()));
     }
 
     /**
@@ -74,8 +149,14 @@ class http_session
      */
     void do_read()
     {
-        // Construct a new parser for each incoming message.
-        parser_.emplace();
+        // Construct a new parser for each incoming message, recycling the arena
+        // once the previous request is gone.
+        parser_.reset();
+        arena_.reset();
+        parser_.emplace(
+                std::piecewise_construct,
+                std::make_tuple(arena_allocator<char>(arena_)),
+                std::make_tuple(arena_allocator<char>(arena_)));
 
         // Apply a reasonable limit to the allowed size of the body in bytes to prevent abuse.
         parser_->body_limit(10000);
@@ -84,7 +165,46 @@ class http_session
         beast::get_lowest_layer(
                 derived().stream()).expires_after(std::chrono::seconds(30));
 
-        // Start reading the request asynchronously using the parser-oriented interface.
+        // Pipelined bytes are already buffered, so parsing starts right away;
+        // otherwise it starts when the first read completes.
+        parse_start_ = buffer_.size() ? std::chrono::steady_clock::now()
+                                      : std::chrono::steady_clock::time_point{};
+
+        // Read what is available, then the rest of the request if it is incomplete.
+        http::async_read_some(
+                derived().stream(),
+                buffer_,
+                *parser_,
+                beast::bind_front_handler(
+                    &http_session::on_read_some,
+                    derived().shared_from_this()));
+    }
+
+    /**
+     * @brief Handle the first read of a request.
+     * 
+     * Marks the start of parsing and, if the request is not complete yet, continues
+     * reading it with the parser-oriented interface.
+     * 
+     * @param ec The error code from the read operation.
+     * @param bytes_transferred The number of bytes transferred during the read operation.
+     */
+    void on_read_some(beast::error_code ec, std::size_t bytes_transferred)
+    {
+        if(parse_start_ == std::chrono::steady_clock::time_point{})
+            parse_start_ = std::chrono::steady_clock::now();
+
+        if(created_ != std::chrono::steady_clock::time_point{})
+        {
+            metrics::record(metrics::detect_to_first_byte, parse_start_ - created_);
+            created_ = {};
+        }
+
+        if(ec || parser_->is_done())
+            return on_read(ec, bytes_transferred);
+
+        metrics::add(metrics::bytes_in, bytes_transferred);
+
         http::async_read(
                 derived().stream(),
                 buffer_,
@@ -105,7 +225,7 @@ class http_session
      */
     void on_read(beast::error_code ec, std::size_t bytes_transferred)
     {
-        boost::ignore_unused(bytes_transferred);
+        metrics::add(metrics::bytes_in, bytes_transferred);
 
         // If the connection was closed by the client, close the session.
         if(ec == http::error::end_of_stream)
@@ -120,14 +240,89 @@ class http_session
             // Disable the timeout, as WebSocket has its own timeout management.
             beast::get_lowest_layer(derived().stream()).expires_never();
 
-            // Create a WebSocket session and transfer ownership of the socket and request.
+            // Create a WebSocket session and transfer ownership of the socket and a copy
+            // of the request that no longer refers to this session's arena.
             return make_websocket_session(
                     derived().release_stream(),
-                    parser_->release());
+                    detach(parser_->release()));
+        }
+
+        metrics::add(metrics::requests);
+
+        auto const parsed = std::chrono::steady_clock::now();
+        metrics::record(metrics::parse, parsed - parse_start_);
+
+        bool const logging = access_log::instance().enabled();
+
+        access_entry access;
+        if(logging)
+        {
+            access.method = parser_->get().method();
+            auto const target = parser_->get().target();
+            access.set_target({target.data(), target.size()});
+            access.parse_us = elapsed_us(parse_start_, parsed);
+        }
+
+        // Let file bodies bypass user space when the stream allows it, or at least keep
+        // their disk reads off this thread.
+        request_context ctx;
+        ctx.defer_file_body = derived().can_sendfile() || file_io::instance().enabled();
+        ctx.remote = remote();
+
+        // With file_io, the handler runs on its threads too, so the open(2) and stat(2)
+        // calls of cache misses do not stall this thread. The next request is read
+        // once the response is queued, since the request still lives in the arena.
+        // The request is destroyed here, before posting back: the arena is not
+        // thread-safe and do_read() resets it as soon as the response is queued.
+        if(file_io::instance().enabled())
+        {
+            return file_io::instance().post(
+                [self = derived().shared_from_this(), req = parser_->release(), ctx = std::move(ctx), access, parsed]() mutable
+                {
+                    auto response = [&]
+                    {
+                        auto request = std::move(req);
+                        return handle_request(*self->doc_root_, std::move(request), ctx);
+                    }();
+                    auto const handled = std::chrono::steady_clock::now();
+                    net::post(self->stream().get_executor(),
+                        [self, response = std::move(response), ctx = std::move(ctx), access, parsed, handled]() mutable
+                        {
+                            self->on_handled(std::move(response), std::move(ctx), access, parsed, handled);
+                        });
+                });
         }
 
         // Handle the HTTP request and queue the response.
-        queue_write(handle_request(*doc_root_, parser_->release()));
+        auto response = handle_request(*doc_root_, parser_->release(), ctx);
+        on_handled(std::move(response), std::move(ctx), access, parsed, std::chrono::steady_clock::now());
+    }
+
+    /**
+     * @brief Queue the response of a handled request and read the next one.
+     * 
+     * @param response The response to the request.
+     * @param ctx The request context, carrying any file body left for the session.
+     * @param access The access log entry for the request, if access logging is enabled.
+     * @param parsed When the request was parsed.
+     * @param handled When the handler returned.
+     */
+    void on_handled(
+            http::message_generator response,
+            request_context ctx,
+            access_entry access,
+            std::chrono::steady_clock::time_point parsed,
+            std::chrono::steady_clock::time_point handled)
+    {
+        metrics::record(metrics::handle, handled - parsed);
+
+        if(access_log::instance().enabled())
+        {
+            access.status = static_cast<unsigned>(ctx.status);
+            access.handle_us = elapsed_us(parsed, handled);
+        }
+
+        queue_write(std::move(response), std::move(ctx), access);
 
         // If the response queue is not full, read the next request.
         if (response_queue_.size() < queue_limit)
@@ -140,11 +335,15 @@ class http_session
      * This method adds a response to the queue and starts the write loop if it's not already running.
      * 
      * @param response The HTTP response to be queued for writing.
+     * @param ctx The request context, carrying any file body to send after the response.
+     * @param access The access log entry for the request, if access logging is enabled.
      */
-    void queue_write(http::message_generator response)
+    void queue_write(http::message_generator response, request_context&& ctx, access_entry const& access = {})
     {
         // Add the response to the queue.
-        response_queue_.push(std::move(response));
+        response_queue_.push({std::move(response), std::move(ctx.file), ctx.window_bits, std::move(ctx.ranges),
+                              access, 0, parse_start_, {}});
+        metrics::add(metrics::queued_responses);
 
         // If this is the only response in the queue, start the write loop.
         if (response_queue_.size() == 1)
@@ -161,19 +360,87 @@ class http_session
     {
         if(! response_queue_.empty())
         {
-            bool keep_alive = response_queue_.front().keep_alive();
+            bool keep_alive = response_queue_.front().message.keep_alive();
+            response_queue_.front().write_start = std::chrono::steady_clock::now();
+            derived().before_write();
 
             // Write the response asynchronously.
             beast::async_write(
                     derived().stream(),
-                    std::move(response_queue_.front()),
+                    std::move(response_queue_.front().message),
                     beast::bind_front_handler(
-                        &http_session::on_write,
+                        &http_session::on_write_header,
                         derived().shared_from_this(),
                         keep_alive));
         }
     }
 
+    /**
+     * @brief Handle the completion of writing the serialized response.
+     * 
+     * If the response carries a deferred file body, it is sent next with sendfile(2)
+     * straight from the file descriptor to the socket, or where the stream cannot
+     * use sendfile, read on the file_io threads and written chunk by chunk.
+     * Multipart spans and compressed streams are always read on the file_io
+     * threads. Otherwise the write is complete.
+     * 
+     * @param keep_alive Whether to keep the connection alive.
+     * @param ec The error code from the write operation.
+     * @param bytes_transferred The number of bytes transferred during the write operation.
+     */
+    void on_write_header(
+            bool keep_alive,
+            beast::error_code ec,
+            std::size_t bytes_transferred)
+    {
+        auto& response = response_queue_.front();
+        file_payload& file = response.file;
+        if(ec || (file.size == 0 && ! response.ranges.file))
+            return on_write(keep_alive, ec, bytes_transferred);
+
+        response.header_bytes = bytes_transferred;
+
+        if(response.ranges.file)
+            return async_copy_file(
+                derived().stream(),
+                std::move(response.ranges),
+                std::chrono::seconds(30),
+                beast::bind_front_handler(
+                    &http_session::on_write,
+                    derived().shared_from_this(),
+                    keep_alive));
+
+        if(response.window_bits)
+            return async_deflate_file(
+                derived().stream(),
+                std::move(file),
+                response.window_bits,
+                std::chrono::seconds(30),
+                beast::bind_front_handler(
+                    &http_session::on_write,
+                    derived().shared_from_this(),
+                    keep_alive));
+
+        if(! derived().can_sendfile())
+            return async_copy_file(
+                derived().stream(),
+                std::move(file),
+                std::chrono::seconds(30),
+                beast::bind_front_handler(
+                    &http_session::on_write,
+                    derived().shared_from_this(),
+                    keep_alive));
+
+        async_sendfile(
+                beast::get_lowest_layer(derived().stream()).socket(),
+                std::move(file),
+                std::chrono::seconds(30),
+                beast::bind_front_handler(
+                    &http_session::on_write,
+                    derived().shared_from_this(),
+                    keep_alive));
+    }
+
     /**
      * @brief Handle the completion of the write operation.
      * 
@@ -189,11 +456,25 @@ class http_session
             beast::error_code ec,
             std::size_t bytes_transferred)
     {
-        boost::ignore_unused(bytes_transferred);
-
         if(ec)
             return fail(ec, "write");
 
+        auto& response = response_queue_.front();
+        auto const now = std::chrono::steady_clock::now();
+        auto const bytes = response.header_bytes + bytes_transferred;
+
+        metrics::add(metrics::bytes_out, bytes);
+        metrics::observe_latency(now - response.request_start);
+        metrics::record(metrics::write, now - response.write_start);
+
+        if(access_log::instance().enabled())
+        {
+            response.access.time = std::chrono::system_clock::now();
+            response.access.bytes = bytes;
+            response.access.write_us = elapsed_us(response.write_start, now);
+            access_log::instance().record(response.access);
+        }
+
         if(! keep_alive)
         {
             // Close the connection if the response indicated "Connection: close".
@@ -206,6 +487,7 @@ class http_session
 
         // Remove the response that was just written.
         response_queue_.pop();
+        metrics::add(metrics::queued_responses, -1);
 
         // Continue writing the next response in the queue.
         do_write();
@@ -4,10 +4,14 @@
 #include "../util/beast.hpp"
 #include "../util/util.hpp"
 #include "detect_session.hpp"
+#include "../util/metrics.hpp"
+#include "../util/tls_context.hpp"
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <boost/asio/ssl.hpp>
 #include <memory>
+#include <cerrno>
+#include <sys/socket.h>
 
 /**
  * @brief The listener class is responsible for accepting incoming TCP connections.
@@ -18,7 +22,7 @@
 class listener : public std::enable_shared_from_this<listener>
 {
     net::io_context& ioc_; ///< The I/O context to be used for asynchronous operations.
-    ssl::context& ctx_; ///< The SSL context used for managing SSL settings and certificates.
+    tls_context& tls_; ///< Publishes the SSL context for new connections, replaced on certificate reloads.
     tcp::acceptor acceptor_; ///< The acceptor object that will listen for new connections.
     std::shared_ptr<std::string const> doc_root_; ///< The root directory for serving HTTP content.
 
@@ -26,17 +30,18 @@ class listener : public std::enable_shared_from_this<listener>
     /**
      * @brief Constructor for the listener class.
      * 
-     * This constructor initializes the listener with the I/O context, SSL context, endpoint, and document root.
+     * This constructor initializes the listener with the I/O context, TLS context, endpoint, and document root.
      * It also sets up the acceptor to listen for incoming connections.
      * 
      * @param ioc The I/O context to use for asynchronous operations.
-     * @param ctx The SSL context used to manage SSL settings and certificates.
+     * @param tls The source of the current SSL context, read once per accepted connection.
      * @param endpoint The TCP endpoint on which to listen for incoming connections.
      * @param doc_root The root directory for serving HTTP content.
+     * @param reuse_port Bind with SO_REUSEPORT so several listeners can share the endpoint.
      */
-    listener(net::io_context& ioc, ssl::context& ctx, tcp::endpoint endpoint, std::shared_ptr<std::string const> const& doc_root)
+    listener(net::io_context& ioc, tls_context& tls, tcp::endpoint endpoint, std::shared_ptr<std::string const> const& doc_root, bool reuse_port = false)
         : ioc_(ioc)
-          , ctx_(ctx)
+          , tls_(tls)
           , acceptor_(net::make_strand(ioc))
           , doc_root_(doc_root)
     {
@@ -58,6 +63,18 @@ class listener : public std::enable_shared_from_this<listener>
             return;
         }
 
+        // Let one listener per io_context bind the same endpoint; the kernel then
+        // balances incoming connections between them.
+        if(reuse_port)
+        {
+            int const on = 1;
+            if(::setsockopt(acceptor_.native_handle(), SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0)
+            {
+                fail(beast::error_code(errno, beast::system_category()), "set_option");
+                return;
+            }
+        }
+
         // Bind the acceptor to the endpoint.
         acceptor_.bind(endpoint, ec);
         if(ec)
@@ -120,10 +137,13 @@ class listener : public std::enable_shared_from_this<listener>
         }
         else
         {
-            // Create a new session to handle the connection.
+            metrics::add(metrics::accepts);
+
+            // Create a new session to handle the connection. It keeps the context
+            // current at accept time, whatever reloads happen during its lifetime.
             std::make_shared<detect_session>(
                     std::move(socket),
-                    ctx_,
+                    tls_.current(),
                     doc_root_)->run();
         }
 
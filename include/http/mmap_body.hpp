@@ -0,0 +1,135 @@
+#ifndef MMAP_BODY_HPP
+#define MMAP_BODY_HPP
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <sys/mman.h>
+
+namespace beast = boost::beast; // Namespace alias for Boost.Beast
+namespace http = beast::http;   // Namespace alias for Boost.Beast's HTTP module
+
+/**
+ * @brief A read-only, shared mapping of a whole file.
+ *
+ * The pages are the page cache itself, so a mapped file is written to a socket
+ * without first being read into a buffer. The mapping lives until the last body
+ * referring to it is destroyed. A file truncated while it is mapped raises SIGBUS
+ * on access, so only files that are replaced by rename may be mapped.
+ */
+class mapped_file
+{
+    void* data_;            ///< Start of the mapping
+    std::uint64_t size_;    ///< Length of the mapping
+
+    mapped_file(void* data, std::uint64_t size)
+        : data_(data)
+        , size_(size)
+    {
+    }
+
+public:
+    /**
+     * @brief Map a file and ask the kernel to read it ahead for sequential access.
+     *
+     * @param fd An open descriptor of the file.
+     * @param size The size of the file.
+     * @return The mapping, or null if the file could not be mapped.
+     */
+    static std::shared_ptr<mapped_file const> map(int fd, std::uint64_t size)
+    {
+        if(size == 0)
+            return nullptr;
+
+        void* data = ::mmap(nullptr, static_cast<std::size_t>(size), PROT_READ, MAP_SHARED, fd, 0);
+        if(data == MAP_FAILED)
+            return nullptr;
+
+        ::madvise(data, static_cast<std::size_t>(size), MADV_SEQUENTIAL);
+        ::madvise(data, static_cast<std::size_t>(size), MADV_WILLNEED);
+        return std::shared_ptr<mapped_file const>(new mapped_file(data, size));
+    }
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    ~mapped_file()
+    {
+        ::munmap(data_, static_cast<std::size_t>(size_));
+    }
+
+    char const* data() const
+    {
+        return static_cast<char const*>(data_);
+    }
+
+    std::uint64_t size() const
+    {
+        return size_;
+    }
+};
+
+/**
+ * @brief A response body that sends a span of a mapped file.
+ *
+ * The serializer is handed the mapped pages directly, so neither plain nor TLS
+ * writes go through an intermediate read buffer, and any number of concurrent
+ * responses can share one mapping. Only the writer (serialization) side is provided.
+ */
+struct mmap_body
+{
+    /**
+     * @brief The mapping and the span of it to send.
+     */
+    struct value_type
+    {
+        std::shared_ptr<mapped_file const> map;     ///< The mapped file
+        std::uint64_t offset = 0;                   ///< First byte of the span
+        std::uint64_t size = 0;                     ///< Length of the span
+    };
+
+    /**
+     * @brief Returns the payload size of the body.
+     *
+     * @param body The body to measure.
+     * @return The number of bytes in the span.
+     */
+    static std::uint64_t size(value_type const& body)
+    {
+        return body.size;
+    }
+
+    /**
+     * @brief Serializer algorithm, yields the whole span in a single step.
+     */
+    class writer
+    {
+        value_type const& body_; ///< The body being serialized
+
+    public:
+        using const_buffers_type = boost::asio::const_buffer;
+
+        template<bool isRequest, class Fields>
+        writer(http::header<isRequest, Fields> const&, value_type const& body)
+            : body_(body)
+        {
+        }
+
+        void init(beast::error_code& ec)
+        {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec)
+        {
+            ec = {};
+            if(! body_.map || body_.size == 0)
+                return boost::none;
+            return {{const_buffers_type(body_.map->data() + body_.offset, static_cast<std::size_t>(body_.size)), false}};
+        }
+    };
+};
+
+#endif // MMAP_BODY_HPP
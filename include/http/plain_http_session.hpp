@@ -83,6 +83,27 @@ class plain_http_session
         return stream_;
     }
 
+    /**
+     * @brief Check whether file bodies can be sent with sendfile(2).
+     * 
+     * Always true for plain TCP, where file bytes go to the socket unmodified.
+     * 
+     * @return True.
+     */
+    bool can_sendfile() const
+    {
+        return true;
+    }
+
+    /**
+     * @brief Prepare the stream for the next response.
+     * 
+     * Nothing to do for plain TCP.
+     */
+    void before_write()
+    {
+    }
+
     /**
      * @brief Release ownership of the TCP stream.
      * 
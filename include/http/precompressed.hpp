@@ -0,0 +1,139 @@
+#ifndef PRECOMPRESSED_HPP
+#define PRECOMPRESSED_HPP
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Index of precompressed siblings of static files ("app.js.br", "app.js.gz", ...).
+ *
+ * The first lookup of a file stats it and its candidate siblings; the result is
+ * cached until file_watcher reports a change to the file, one of its siblings or
+ * their directory, or until it is the least recently used of too many, so
+ * steady-state lookups cost no system calls. A sibling is only
+ * used if it is a regular file at least as new as the original. Without inotify
+ * the index is disabled and every file is served as is.
+ */
+class precompressed
+{
+public:
+    /**
+     * @brief Content codings, as bits, in order of server preference.
+     */
+    enum coding : unsigned
+    {
+        br = 1,
+        zstd = 2,
+        gzip = 4,
+        deflate = 8     ///< Never precompressed, only produced on the fly by compression
+    };
+
+    /**
+     * @brief The sibling suffix and Content-Encoding token of a coding.
+     */
+    struct variant
+    {
+        coding bit;
+        char const* suffix;
+        char const* token;
+    };
+
+    static constexpr std::array<variant, 3> variants{{
+        {br, ".br", "br"},
+        {zstd, ".zst", "zstd"},
+        {gzip, ".gz", "gzip"},
+    }};
+
+    /**
+     * @brief Access the shared index instance.
+     *
+     * @return A reference to the process-wide index.
+     */
+    static precompressed& instance();
+
+    /**
+     * @brief Bound the index.
+     *
+     * Must be called before the I/O threads start serving requests.
+     *
+     * @param capacity The maximum number of files whose siblings are remembered.
+     */
+    void configure(std::size_t capacity);
+
+    /**
+     * @brief Get the usable precompressed siblings of a file.
+     *
+     * @param path The path of the original file.
+     * @return A mask of coding bits, 0 if there are none or the file does not exist.
+     */
+    unsigned lookup(std::string const& path);
+
+    /**
+     * @brief Parse an Accept-Encoding header value.
+     *
+     * @param header The header value.
+     * @return A mask of the codings the client accepts with a non-zero quality.
+     */
+    static unsigned accepted(std::string_view header);
+
+    /**
+     * @brief Pick the variant to serve.
+     *
+     * @param available The siblings of the file.
+     * @param accepted The codings the client accepts.
+     * @return The preferred variant, or null to serve the original.
+     */
+    static variant const* choose(unsigned available, unsigned accepted);
+
+private:
+    precompressed();
+
+    /**
+     * @brief Drop cached lookups for a changed path.
+     *
+     * @param path A file, a directory (drops every file in it), or an empty string for all.
+     */
+    void invalidate(std::string const& path);
+
+    /**
+     * @brief Cached siblings of one original path.
+     */
+    struct slot
+    {
+        unsigned mask;                          ///< The usable siblings
+        std::list<std::string>::iterator lru;   ///< Position in the recency list
+    };
+
+    /**
+     * @brief Remove a cached path, its siblings and its directory's reference to it.
+     *
+     * Must be called with mutex_ held.
+     */
+    void erase(std::unordered_map<std::string, slot>::iterator it);
+
+    /**
+     * @brief Stat a file and its siblings.
+     *
+     * @param path The path of the original file.
+     * @param exists Set to true if the original is a regular file.
+     * @return The mask of usable siblings.
+     */
+    static unsigned probe(std::string const& path, bool& exists);
+
+    bool enabled_ = false;                                                  ///< Whether inotify is available
+    std::size_t capacity_ = 10000;                                          ///< Maximum number of cached originals
+    std::mutex mutex_;                                                      ///< Protects the members below
+    std::uint64_t generation_ = 0;                                          ///< Bumped on every invalidation
+    std::list<std::string> lru_;                                            ///< Cached originals, most recently used first
+    std::unordered_map<std::string, slot> entries_;                         ///< Sibling masks by original path
+    std::unordered_map<std::string, std::string> owners_;                   ///< Original path by sibling path
+    std::unordered_map<std::string, std::vector<std::string>> directories_; ///< Cached originals by directory
+};
+
+#endif // PRECOMPRESSED_HPP
@@ -4,8 +4,26 @@
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
+#include "file_cache.hpp"
+#include "fd_cache.hpp"
+#include "shared_buffer_body.hpp"
+#include "sendfile.hpp"
+#include "router.hpp"
+#include "precompressed.hpp"
+#include "compression.hpp"
+#include "deflate_body.hpp"
+#include "file_io.hpp"
+#include "byte_range.hpp"
+#include "file_ranges_body.hpp"
+#include "validators.hpp"
+#include "admin_access.hpp"
+#include "../util/timestamp.hpp"
+#include "../util/metrics.hpp"
 #include <string>
 #include <memory>
+#include <random>
+#include <vector>
+#include <sys/stat.h>
 
 namespace beast = boost::beast; // Namespace alias for Boost.Beast
 namespace http = beast::http;   // Namespace alias for Boost.Beast's HTTP module
@@ -47,6 +65,13 @@ inline beast::string_view mime_type(beast::string_view path)
     return "application/text";
 }
 
+// Current time as an HTTP Date header value, formatted at most once per second
+inline beast::string_view http_date()
+{
+    auto const date = timestamp::http_date();
+    return {date.data(), date.size()};
+}
+
 // Concatenate a base path and a relative path
 inline std::string path_cat(beast::string_view base, beast::string_view path)
 {
@@ -73,16 +98,79 @@ inline std::string path_cat(beast::string_view base, beast::string_view path)
     return result;
 }
 
+// Open a file for a response that reads it through the file position
+inline bool open_private(beast::file& file, std::string const& path)
+{
+    beast::error_code ec;
+    file.open(path.c_str(), beast::file_mode::scan, ec);
+    return ! ec;
+}
+
+// Content-Range value of one span of a representation
+inline std::string content_range(byte_range const& r, std::uint64_t size)
+{
+    return "bytes " + std::to_string(r.offset) + "-" + std::to_string(r.offset + r.size - 1) +
+        "/" + std::to_string(size);
+}
+
+// A random multipart boundary, unlikely to occur in the file contents
+inline std::string make_boundary()
+{
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string boundary(24, '0');
+    for(auto& c : boundary)
+        c = digits[rng() & 15];
+    return boundary;
+}
+
+// Whether an If-Range condition (absent, the file's entity tag or its modification date) still holds
+template<class Body, class Allocator>
+bool if_range_holds(http::request<Body, http::basic_fields<Allocator>> const& req, validators::entry const* file)
+{
+    auto const value = req[http::field::if_range];
+    if(value.empty())
+        return true;
+    if(! file)
+        return false;
+
+    std::string_view const condition(value.data(), value.size());
+    if(condition.front() == '"' || condition.substr(0, 2) == "W/")
+        return validators::strong_match(condition, file->etag);
+
+    std::time_t since;
+    return timestamp::parse_http_date(condition, since) && file->mtime == since;
+}
+
+// Whether If-None-Match, or failing that If-Modified-Since, shows the client's copy is current
+template<class Body, class Allocator>
+bool not_modified(http::request<Body, http::basic_fields<Allocator>> const& req,
+                  validators::entry const& file, std::string_view etag)
+{
+    auto const none_match = req[http::field::if_none_match];
+    if(! none_match.empty())
+        return validators::none_match({none_match.data(), none_match.size()}, etag);
+
+    auto const modified_since = req[http::field::if_modified_since];
+    std::time_t since;
+    return ! modified_since.empty()
+        && timestamp::parse_http_date({modified_since.data(), modified_since.size()}, since)
+        && file.mtime <= since;
+}
+
 // Send an HTTP response with the given status and body
 template<class Body, class Allocator>
 http::message_generator send_(
     http::request<Body, http::basic_fields<Allocator>> const& req,
+    request_context& ctx,
     http::status status,
     beast::string_view body,
     beast::string_view content_type = "text/html")
 {
+    ctx.status = status;
     http::response<http::string_body> res{status, req.version()};
     res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::date, http_date());
     res.set(http::field::content_type, content_type);
     res.keep_alive(req.keep_alive());
     res.body() = std::string(body);
@@ -94,95 +182,460 @@ http::message_generator send_(
 template<class Body, class Allocator>
 http::message_generator handle_get(
     beast::string_view doc_root,
-    http::request<Body, http::basic_fields<Allocator>>&& req)
+    http::request<Body, http::basic_fields<Allocator>>&& req,
+    request_context& ctx)
 {
     std::string path = path_cat(doc_root, req.target());
     if(req.target().back() == '/')
         path.append("index.html");
 
-    beast::error_code ec;
-    http::file_body::value_type body;
-    body.open(path.c_str(), beast::file_mode::scan, ec);
+    auto const content_type = mime_type(path);
+    auto const accept_encoding = req[http::field::accept_encoding];
+    auto const accepted = precompressed::accepted(
+        std::string_view(accept_encoding.data(), accept_encoding.size()));
+
+    // Prefer a precompressed sibling the client accepts; the original path still
+    // determines the Content-Type. Without one, compress on the fly if worthwhile.
+    auto const variants = precompressed::instance().lookup(path);
+    auto const* variant = precompressed::choose(variants, accepted);
+    std::string const file_path = variant ? path + variant->suffix : path;
+
+    // Ranges refer to the stored bytes, so a range request is never compressed on the fly.
+    bool const wants_range = req.method() == http::verb::get && req.find(http::field::range) != req.end();
+
+    auto& zip = compression::instance();
+    unsigned const coding = variant || wants_range ? 0 : zip.negotiate(accepted, {content_type.data(), content_type.size()});
+    bool const vary = variants || zip.compressible({content_type.data(), content_type.size()});
+    char const* encoding = variant ? variant->token : nullptr;
+
+    // Validators of the file actually read; the tag of compressed output names its coding.
+    auto const validator = validators::instance().lookup(file_path);
+    auto const etag = [&](char const* coding) { return validators::tag(validator->etag, variant ? nullptr : coding); };
+
+    // Headers shared by every successful response.
+    auto const prepare = [&](auto& res, std::uint64_t size)
+    {
+        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        res.set(http::field::date, http_date());
+        res.set(http::field::content_type, content_type);
+        if(encoding)
+            res.set(http::field::content_encoding, encoding);
+        if(vary)
+            res.set(http::field::vary, "Accept-Encoding");
+        if(validator)
+        {
+            res.set(http::field::etag, etag(encoding));
+            res.set(http::field::last_modified, validator->last_modified);
+        }
+        // A range request is answered with identity bytes, so output compressed on
+        // the fly must not invite a client to resume it with one.
+        res.set(http::field::accept_ranges, encoding && ! variant ? "none" : "bytes");
+        res.content_length(size);
+        res.keep_alive(req.keep_alive());
+    };
+
+    // Whether a file of this size and version is sent compressed, with the memoized
+    // output when it is ready and streamed through zlib otherwise. HEAD decides like
+    // GET. HTTP/1.0 has no chunked encoding, so it only gets memoized output.
+    auto const compressed = [&](std::uint64_t size, std::int64_t mtime, compression::buffer_type& data)
+    {
+        if(! coding || ! zip.worth_compressing(size))
+            return false;
+        if(zip.cacheable(size) && (data = zip.get(file_path, mtime, coding)))
+            return true;
+        return req.version() >= 11;
+    };
+
+    // Answer revalidations from the cached validators, without opening the file. The
+    // coding is decided exactly as for the response being revalidated.
+    if(validator)
+    {
+        compression::buffer_type data;
+        char const* const predicted = compressed(validator->size, validator->mtime_ns, data)
+            ? compression::token(coding) : encoding;
+        auto const current = etag(predicted);
+        if(not_modified(req, *validator, current))
+        {
+            ctx.status = http::status::not_modified;
+            http::response<http::empty_body> res{http::status::not_modified, req.version()};
+            res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+            res.set(http::field::date, http_date());
+            res.set(http::field::etag, current);
+            res.set(http::field::last_modified, validator->last_modified);
+            if(vary)
+                res.set(http::field::vary, "Accept-Encoding");
+            res.keep_alive(req.keep_alive());
+            return res;
+        }
+    }
+
+    // Hot files come from the descriptor cache, already open and stat'ed.
+    auto const cached = fd_cache::instance().get(file_path);
+
+    // Compression stage: serve memoized output once it is ready and stream everything
+    // else through zlib. Anything below the threshold falls through with the file kept open.
+    beast::file opened;
+    if(coding)
+    {
+        std::uint64_t size = 0;
+        std::int64_t mtime = 0;
+        int fd = -1;
+        if(cached)
+        {
+            size = cached->size;
+            mtime = cached->mtime_ns;
+            fd = cached->file->native_handle();
+        }
+        else
+        {
+            beast::error_code ec;
+            opened.open(file_path.c_str(), beast::file_mode::scan, ec);
+
+            struct stat st;
+            if(! ec && ::fstat(opened.native_handle(), &st) == 0 && S_ISREG(st.st_mode))
+            {
+                size = static_cast<std::uint64_t>(st.st_size);
+                mtime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+                fd = opened.native_handle();
+            }
+        }
+
+        compression::buffer_type data;
+        if(fd >= 0 && compressed(size, mtime, data))
+        {
+            encoding = compression::token(coding);
+            if(data)
+            {
+                if(req.method() == http::verb::head)
+                {
+                    http::response<http::empty_body> res{http::status::ok, req.version()};
+                    prepare(res, data->size());
+                    return res;
+                }
+
+                auto const compressed_size = data->size();
+                http::response<shared_buffer_body> res{
+                    std::piecewise_construct,
+                    std::make_tuple(std::move(data)),
+                    std::make_tuple(http::status::ok, req.version())};
+                prepare(res, compressed_size);
+                return res;
+            }
+
+            // The streamed length is not known up front, so HEAD leaves it out.
+            if(req.method() == http::verb::head)
+            {
+                http::response<http::empty_body> res{http::status::ok, req.version()};
+                prepare(res, 0);
+                res.content_length(boost::none);
+                return res;
+            }
+
+            // With file_io, the session reads and compresses the file on its threads.
+            if(file_io::instance().enabled())
+            {
+                http::response<http::empty_body, chunked_header_fields> res{http::status::ok, req.version()};
+                prepare(res, size);
+                res.chunked(true);
+                ctx.file = {cached ? cached->file : std::make_shared<beast::file>(std::move(opened)), 0, size};
+                ctx.window_bits = compression::window_bits(coding);
+                return res;
+            }
+
+            if(opened.is_open() || open_private(opened, file_path))
+            {
+                http::response<deflate_body> res{http::status::ok, req.version()};
+                res.body().file = std::move(opened);
+                res.body().size = size;
+                res.body().window_bits = compression::window_bits(coding);
+                prepare(res, size);
+                res.content_length(boost::none);
+                res.chunked(true);
+                return res;
+            }
+            encoding = nullptr;
+        }
+    }
+
+    // Serve hot files straight from the shared in-memory cache when it is enabled.
+    if(auto data = wants_range ? file_cache::buffer_type{} : file_cache::instance().get(file_path))
+    {
+        if(req.method() == http::verb::head)
+        {
+            http::response<http::empty_body> res{http::status::ok, req.version()};
+            prepare(res, data->size());
+            return res;
+        }
+
+        auto const size = data->size();
+        http::response<shared_buffer_body> res{
+            std::piecewise_construct,
+            std::make_tuple(std::move(data)),
+            std::make_tuple(http::status::ok, req.version())};
+        prepare(res, size);
+        return res;
+    }
+
+    // The file is only ever read at explicit offsets below, so a cached descriptor
+    // can be shared by any number of responses.
+    std::shared_ptr<beast::file> file;
+    std::uint64_t size = 0;
+    if(cached)
+    {
+        file = cached->file;
+        size = cached->size;
+    }
+    else
+    {
+        beast::error_code ec;
+        if(! opened.is_open())
+            opened.open(file_path.c_str(), beast::file_mode::scan, ec);
+        if(! ec)
+            size = opened.size(ec);
 
-    if(ec == beast::errc::no_such_file_or_directory)
-        return send_(req, http::status::not_found, "The resource was not found.");
+        if(ec == beast::errc::no_such_file_or_directory)
+            return send_(req, ctx, http::status::not_found, "The resource was not found.");
 
-    if(ec)
-        return send_(req, http::status::internal_server_error, ec.message());
+        if(ec)
+            return send_(req, ctx, http::status::internal_server_error, ec.message());
 
-    auto const size = body.size();
+        file = std::make_shared<beast::file>(std::move(opened));
+    }
+
+    // The shared mapping of a cached file within the configured size bounds.
+    auto const mapping = [&]() -> std::shared_ptr<mapped_file const>
+    {
+        return cached && fd_cache::instance().mappable(size) ? cached->mapping() : nullptr;
+    };
 
     if(req.method() == http::verb::head)
     {
         http::response<http::empty_body> res{http::status::ok, req.version()};
+        prepare(res, size);
+        return res;
+    }
+
+    // Serve the requested byte ranges, unless If-Range shows the file has changed.
+    std::vector<byte_range> ranges;
+    auto const range_header = req[http::field::range];
+    auto const range = wants_range && if_range_holds(req, validator.get())
+        ? parse_range({range_header.data(), range_header.size()}, size, ranges)
+        : range_result::ignore;
+
+    if(range == range_result::unsatisfiable)
+    {
+        ctx.status = http::status::range_not_satisfiable;
+        http::response<http::empty_body> res{http::status::range_not_satisfiable, req.version()};
         res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.set(http::field::content_type, mime_type(path));
-        res.content_length(size);
+        res.set(http::field::date, http_date());
+        res.set(http::field::content_range, "bytes */" + std::to_string(size));
+        res.content_length(0);
         res.keep_alive(req.keep_alive());
         return res;
     }
 
-    http::response<http::file_body> res{
-        std::piecewise_construct,
-        std::make_tuple(std::move(body)),
-        std::make_tuple(http::status::ok, req.version())};
-    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-    res.set(http::field::content_type, mime_type(path));
-    res.content_length(size);
-    res.keep_alive(req.keep_alive());
+    if(range == range_result::satisfiable)
+    {
+        ctx.status = http::status::partial_content;
+
+        if(ranges.size() == 1)
+        {
+            auto const& r = ranges.front();
+
+            // A single span goes out with sendfile(2) like a whole file.
+            if(ctx.defer_file_body)
+            {
+                http::response<http::empty_body> res{http::status::partial_content, req.version()};
+                prepare(res, r.size);
+                res.set(http::field::content_range, content_range(r, size));
+                ctx.file = {std::move(file), r.offset, r.size};
+                return res;
+            }
+
+            if(auto map = mapping())
+            {
+                http::response<mmap_body> res{http::status::partial_content, req.version()};
+                res.body() = {std::move(map), r.offset, r.size};
+                prepare(res, r.size);
+                res.set(http::field::content_range, content_range(r, size));
+                return res;
+            }
+
+            http::response<file_ranges_body> res{http::status::partial_content, req.version()};
+            res.body().file = std::move(file);
+            res.body().parts.push_back({{}, r.offset, r.size});
+            prepare(res, r.size);
+            res.set(http::field::content_range, content_range(r, size));
+            return res;
+        }
+
+        // Several spans: a multipart/byteranges payload, each part with its own headers.
+        auto const boundary = make_boundary();
+        file_ranges_body::value_type body;
+        body.file = std::move(file);
+        for(auto const& r : ranges)
+        {
+            std::string prefix = body.parts.empty() ? "--" : "\r\n--";
+            prefix.append(boundary).append("\r\nContent-Type: ").append(content_type.data(), content_type.size());
+            prefix.append("\r\nContent-Range: ").append(content_range(r, size)).append("\r\n\r\n");
+            body.parts.push_back({std::move(prefix), r.offset, r.size});
+        }
+        body.suffix = "\r\n--" + boundary + "--\r\n";
+        auto const payload_size = file_ranges_body::size(body);
+
+        // With file_io, the session reads the spans on its threads.
+        if(file_io::instance().enabled())
+        {
+            http::response<http::empty_body> res{http::status::partial_content, req.version()};
+            prepare(res, payload_size);
+            res.set(http::field::content_type, "multipart/byteranges; boundary=" + boundary);
+            ctx.ranges = std::move(body);
+            return res;
+        }
+
+        http::response<file_ranges_body> res{http::status::partial_content, req.version()};
+        res.body() = std::move(body);
+        prepare(res, payload_size);
+        res.set(http::field::content_type, "multipart/byteranges; boundary=" + boundary);
+        return res;
+    }
+
+    // Send only the header and leave the file to the session, which copies it
+    // to the socket in the kernel with sendfile(2).
+    if(ctx.defer_file_body)
+    {
+        http::response<http::empty_body> res{http::status::ok, req.version()};
+        prepare(res, size);
+        ctx.file = {std::move(file), 0, size};
+        return res;
+    }
+
+    // Otherwise mid-sized cached files are written straight from their shared mapping.
+    if(auto map = mapping())
+    {
+        http::response<mmap_body> res{http::status::ok, req.version()};
+        res.body() = {std::move(map), 0, size};
+        prepare(res, size);
+        return res;
+    }
+
+    http::response<file_ranges_body> res{http::status::ok, req.version()};
+    res.body().file = std::move(file);
+    res.body().parts.push_back({{}, 0, size});
+    prepare(res, size);
     return res;
 }
 
 // Handle POST requests
 template<class Body, class Allocator>
 http::message_generator handle_post(
-    http::request<Body, http::basic_fields<Allocator>>&& req)
+    http::request<Body, http::basic_fields<Allocator>>&& req,
+    request_context& ctx)
 {
     // Handle the POST request. You may need to parse JSON or handle form data here.
     // For demonstration, we'll just return a simple message.
-    return send_(req, http::status::ok, "POST request received.");
+    return send_(req, ctx, http::status::ok, "POST request received.");
 }
 
 // Handle PUT requests
 template<class Body, class Allocator>
 http::message_generator handle_put(
-    http::request<Body, http::basic_fields<Allocator>>&& req)
+    http::request<Body, http::basic_fields<Allocator>>&& req,
+    request_context& ctx)
 {
     // Handle the PUT request. You may need to update resources on the server.
     // For demonstration, we'll just return a simple message.
-    return send_(req, http::status::ok, "PUT request received.");
+    return send_(req, ctx, http::status::ok, "PUT request received.");
 }
 
 // Handle DELETE requests
 template<class Body, class Allocator>
 http::message_generator handle_delete(
-    http::request<Body, http::basic_fields<Allocator>>&& req)
+    http::request<Body, http::basic_fields<Allocator>>&& req,
+    request_context& ctx)
 {
     // Handle the DELETE request. You may need to delete resources on the server.
     // For demonstration, we'll just return a simple message.
-    return send_(req, http::status::ok, "DELETE request received.");
+    return send_(req, ctx, http::status::ok, "DELETE request received.");
+}
+
+// Serve the runtime counters in the Prometheus text format
+template<class Body, class Allocator>
+http::message_generator handle_metrics(
+    http::request<Body, http::basic_fields<Allocator>>&& req,
+    request_context& ctx)
+{
+    if(! admin_access::instance().allowed(ctx.remote))
+        return send_(req, ctx, http::status::not_found, "The resource was not found.");
+    return send_(req, ctx, http::status::ok, metrics::render(), "text/plain; version=0.0.4");
 }
 
-// Main request handler that delegates to specific methods
+// Serve the per-stage latency percentiles as a table
 template<class Body, class Allocator>
-http::message_generator handle_request(
+http::message_generator handle_latency(
+    http::request<Body, http::basic_fields<Allocator>>&& req,
+    request_context& ctx)
+{
+    if(! admin_access::instance().allowed(ctx.remote))
+        return send_(req, ctx, http::status::not_found, "The resource was not found.");
+    return send_(req, ctx, http::status::ok, metrics::render_stages(), "text/plain");
+}
+
+// Build the route table: admin endpoints, then static files and the demo handlers under "/"
+inline router make_routes()
+{
+    using request_type = router::request_type;
+
+    router r;
+    r.add(http::verb::get, "/metrics",
+        [](request_type&& req, route_match const&, request_context& ctx)
+        { return handle_metrics(std::move(req), ctx); });
+    r.add(http::verb::get, "/admin/latency",
+        [](request_type&& req, route_match const&, request_context& ctx)
+        { return handle_latency(std::move(req), ctx); });
+
+    for(auto method : {http::verb::get, http::verb::head})
+        r.add(method, "/*",
+            [](request_type&& req, route_match const&, request_context& ctx)
+            { return handle_get(ctx.doc_root, std::move(req), ctx); });
+    r.add(http::verb::post, "/*",
+        [](request_type&& req, route_match const&, request_context& ctx)
+        { return handle_post(std::move(req), ctx); });
+    r.add(http::verb::put, "/*",
+        [](request_type&& req, route_match const&, request_context& ctx)
+        { return handle_put(std::move(req), ctx); });
+    r.add(http::verb::delete_, "/*",
+        [](request_type&& req, route_match const&, request_context& ctx)
+        { return handle_delete(std::move(req), ctx); });
+
+    r.compile();
+    return r;
+}
+
+// The process-wide route table, compiled on first use
+inline router const& routes()
+{
+    static router const table = make_routes();
+    return table;
+}
+
+// Main request handler that dispatches through the route table
+inline http::message_generator handle_request(
     beast::string_view doc_root,
-    http::request<Body, http::basic_fields<Allocator>>&& req)
+    router::request_type&& req,
+    request_context& ctx)
 {
-    switch(req.method())
-    {
-        case http::verb::get:
-        case http::verb::head:
-            return handle_get(doc_root, std::move(req));
-        case http::verb::post:
-            return handle_post(std::move(req));
-        case http::verb::put:
-            return handle_put(std::move(req));
-        case http::verb::delete_:
-            return handle_delete(std::move(req));
-        default:
-            return send_(req, http::status::bad_request, "Unknown HTTP-method");
-    }
+    ctx.doc_root = doc_root;
+
+    // Match on the path only; the query string is left for the handler.
+    auto const target = req.target();
+    std::string_view const path(target.data(), std::min(target.find('?'), target.size()));
+
+    route_match match;
+    if(auto const* handler = routes().match(req.method(), path, match))
+        return (*handler)(std::move(req), match, ctx);
+
+    return send_(req, ctx, http::status::bad_request, "Unknown HTTP-method");
 }
 
 #endif // REQUEST_HANDLER_HPP
@@ -0,0 +1,169 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include "sendfile.hpp"
+#include "file_ranges_body.hpp"
+#include "../util/arena.hpp"
+#include <boost/asio/ip/address.hpp>
+#include <boost/beast/http.hpp>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace beast = boost::beast; // Namespace alias for Boost.Beast
+namespace http = beast::http;   // Namespace alias for Boost.Beast's HTTP module
+
+/// Request body stored in the session's arena
+using request_body = http::basic_string_body<char, std::char_traits<char>, arena_allocator<char>>;
+
+/// Request whose fields and body are allocated from the session's arena
+using arena_request = http::request<request_body, http::basic_fields<arena_allocator<char>>>;
+
+/**
+ * @brief Per-request state exchanged between a session and the request handlers.
+ */
+struct request_context
+{
+    beast::string_view doc_root;                ///< The root directory for serving HTTP content
+    bool defer_file_body = false;               ///< Set by the session if it transmits file bodies itself
+    file_payload file;                          ///< File region left for the session, filled by handle_get
+    int window_bits = 0;                        ///< zlib windowBits if the session compresses file into chunks, 0 otherwise
+    file_ranges_body::value_type ranges;        ///< Multipart spans left for the session, filled by handle_get
+    http::status status = http::status::ok;     ///< Status of the response, for the access log
+    boost::asio::ip::address remote;            ///< Address of the client, for admin access checks
+};
+
+/**
+ * @brief The parts of a target captured while matching a route.
+ *
+ * Views point into the request target and the router's compiled patterns, so the
+ * match stays valid only as long as the request it was matched against.
+ */
+struct route_match
+{
+    static constexpr std::size_t max_params = 8;    ///< Parameters captured per route
+
+    std::array<std::pair<std::string_view, std::string_view>, max_params> params; ///< Name and value of each parameter
+    std::size_t param_count = 0;                    ///< Number of captured parameters
+    std::string_view rest;                          ///< Remainder of the path below a prefix mount
+
+    /**
+     * @brief Get a captured parameter by name.
+     *
+     * @param name The parameter name, without the leading ':'.
+     * @return The value, or an empty view if the route has no such parameter.
+     */
+    std::string_view param(std::string_view name) const
+    {
+        for(std::size_t i = 0; i < param_count; ++i)
+            if(params[i].first == name)
+                return params[i].second;
+        return {};
+    }
+};
+
+/**
+ * @brief Dispatches requests to handlers by method and path pattern.
+ *
+ * Patterns consist of static text, parameters and an optional trailing prefix mount:
+ * "/api/users/:id/posts" captures the segment after "/api/users/" as "id", and a
+ * pattern ending in '*', such as "/static/" followed by '*', matches every path that
+ * starts with "/static/". When several routes could match, static text wins over a
+ * parameter, which wins over a mount.
+ *
+ * Routes are added at startup and then compiled into a radix trie stored in three
+ * flat arrays (nodes, routes and one string pool), so matching walks contiguous
+ * memory and never allocates.
+ */
+class router
+{
+public:
+    using request_type = arena_request;
+    using handler_type = std::function<http::message_generator(request_type&&, route_match const&, request_context&)>;
+
+    router();
+    router(router&&) noexcept;
+    router& operator=(router&&) noexcept;
+    ~router();
+
+    /**
+     * @brief Register a handler.
+     *
+     * @param method The request method the route answers.
+     * @param pattern The path pattern, starting with '/'.
+     * @param handler The handler to call for matching requests.
+     * @throws std::invalid_argument if the pattern is malformed or conflicts with a registered route.
+     */
+    void add(http::verb method, std::string_view pattern, handler_type handler);
+
+    /**
+     * @brief Build the lookup trie from the registered routes.
+     *
+     * Must be called once, after the last add() and before the first match().
+     */
+    void compile();
+
+    /**
+     * @brief Find the handler for a request path.
+     *
+     * @param method The request method.
+     * @param path The request path, without the query string.
+     * @param match Receives the captured parameters and mount remainder.
+     * @return The handler, or null if no route matches.
+     */
+    handler_type const* match(http::verb method, std::string_view path, route_match& match) const;
+
+private:
+    struct build_node;
+
+    static constexpr std::uint32_t npos = UINT32_MAX;
+
+    /**
+     * @brief A compiled trie node.
+     *
+     * Static children are stored contiguously, each starting with a distinct character.
+     * A parameter node's text is the parameter name; it consumes one path segment.
+     */
+    struct node
+    {
+        std::uint32_t text_offset = 0;      ///< Static prefix (or parameter name) in text_
+        std::uint32_t text_size = 0;
+        std::uint32_t first_child = 0;      ///< First static child in nodes_
+        std::uint32_t child_count = 0;
+        std::uint32_t param_child = npos;   ///< Parameter child in nodes_, npos if none
+        std::uint32_t first_route = 0;      ///< First route ending here in routes_
+        std::uint32_t route_count = 0;
+    };
+
+    /**
+     * @brief A route ending at a node.
+     */
+    struct route
+    {
+        http::verb method;                  ///< The method it answers
+        bool mount;                         ///< Whether it matches any remainder of the path
+        std::uint32_t handler;              ///< Index in handlers_
+    };
+
+    std::uint32_t flatten(build_node& b);
+    handler_type const* find(node const& n, http::verb method, bool mount) const;
+    handler_type const* match_node(std::uint32_t index, std::string_view path, http::verb method, route_match& m) const;
+
+    std::string_view text_of(node const& n) const
+    {
+        return std::string_view(text_).substr(n.text_offset, n.text_size);
+    }
+
+    std::unique_ptr<build_node> root_;      ///< Routes added but not yet compiled
+    std::vector<node> nodes_;               ///< Compiled trie, root first
+    std::vector<route> routes_;             ///< Routes of all nodes
+    std::vector<handler_type> handlers_;    ///< Registered handlers
+    std::string text_;                      ///< Static prefixes and parameter names
+};
+
+#endif // ROUTER_HPP
@@ -0,0 +1,163 @@
+#ifndef SENDFILE_HPP
+#define SENDFILE_HPP
+
+#include "../util/beast.hpp"
+#include <boost/asio/steady_timer.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sys/sendfile.h>
+
+/**
+ * @brief A region of an open file that a session transmits after the response header.
+ */
+struct file_payload
+{
+    std::shared_ptr<beast::file> file;  ///< The open file, null if there is no payload
+    std::uint64_t offset = 0;           ///< Offset of the first byte to send
+    std::uint64_t size = 0;             ///< Number of bytes to send
+};
+
+/**
+ * @brief State of a single asynchronous sendfile(2) transfer.
+ * 
+ * Bytes are moved from the page cache to the socket by the kernel. When the socket
+ * send buffer is full the operation waits for writability, and the socket is
+ * cancelled if it does not become writable within the timeout.
+ * 
+ * @tparam Handler The completion handler, called as void(error_code, std::size_t).
+ */
+template<class Handler>
+class sendfile_op : public std::enable_shared_from_this<sendfile_op<Handler>>
+{
+    tcp::socket& socket_;                           ///< The destination socket
+    file_payload file_;                             ///< The region left to send
+    std::chrono::steady_clock::duration timeout_;   ///< Maximum time to wait for writability
+    net::steady_timer timer_;                       ///< Timer enforcing the timeout
+    Handler handler_;                               ///< The completion handler
+    std::size_t total_ = 0;                         ///< Bytes sent so far
+    bool timed_out_ = false;                        ///< Whether the timer expired
+    std::uint64_t waits_ = 0;                       ///< Number of waits started or finished, identifying the current one
+
+public:
+    sendfile_op(tcp::socket& socket, file_payload file, std::chrono::steady_clock::duration timeout, Handler handler)
+        : socket_(socket)
+        , file_(std::move(file))
+        , timeout_(timeout)
+        , timer_(socket.get_executor())
+        , handler_(std::move(handler))
+    {
+    }
+
+    /**
+     * @brief Send as much as the socket accepts, then wait or complete.
+     */
+    void step()
+    {
+        beast::error_code ec;
+        socket_.native_non_blocking(true, ec);
+        if(ec)
+            return complete(ec);
+
+        while(file_.size > 0)
+        {
+            off_t offset = static_cast<off_t>(file_.offset);
+            auto const count = static_cast<std::size_t>(
+                std::min<std::uint64_t>(file_.size, 0x7ffff000));
+            ssize_t n = ::sendfile(
+                socket_.native_handle(), file_.file->native_handle(), &offset, count);
+
+            if(n > 0)
+            {
+                file_.offset += static_cast<std::uint64_t>(n);
+                file_.size -= static_cast<std::uint64_t>(n);
+                total_ += static_cast<std::size_t>(n);
+                continue;
+            }
+
+            if(n == 0)
+                return complete(net::error::eof); // File was truncated underneath us
+
+            if(errno == EINTR)
+                continue;
+
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                return wait();
+
+            return complete(beast::error_code(errno, beast::system_category()));
+        }
+
+        complete({});
+    }
+
+private:
+    /**
+     * @brief Wait for the socket to become writable again.
+     * 
+     * Cancelling the timer does not recall a completion that is already queued, so
+     * the timer handler only acts while its own wait is still the current one.
+     */
+    void wait()
+    {
+        auto self = this->shared_from_this();
+        auto const id = ++waits_;
+
+        timer_.expires_after(timeout_);
+        timer_.async_wait(
+            [self, id](beast::error_code ec)
+            {
+                if(ec || id != self->waits_)
+                    return;
+                self->timed_out_ = true;
+                self->socket_.cancel(ec);
+            });
+
+        socket_.async_wait(
+            tcp::socket::wait_write,
+            [self](beast::error_code ec)
+            {
+                ++self->waits_;
+                self->timer_.cancel();
+                if(self->timed_out_)
+                    return self->complete(beast::error::timeout);
+                if(ec)
+                    return self->complete(ec);
+                self->step();
+            });
+    }
+
+    /**
+     * @brief Post the completion handler with the result of the transfer.
+     */
+    void complete(beast::error_code ec)
+    {
+        net::post(
+            socket_.get_executor(),
+            beast::bind_front_handler(std::move(handler_), ec, total_));
+    }
+};
+
+/**
+ * @brief Asynchronously transmit a file region to a socket with sendfile(2).
+ * 
+ * Only valid on sockets whose bytes go to the peer unmodified, i.e. plain TCP or
+ * a TLS connection whose records are sealed by the kernel.
+ * 
+ * @param socket The destination socket.
+ * @param file The file region to send.
+ * @param timeout Maximum time to wait for the socket to become writable.
+ * @param handler Called as void(error_code, std::size_t bytes_transferred).
+ */
+template<class Handler>
+void async_sendfile(
+    tcp::socket& socket,
+    file_payload file,
+    std::chrono::steady_clock::duration timeout,
+    Handler&& handler)
+{
+    std::make_shared<sendfile_op<std::decay_t<Handler>>>(
+        socket, std::move(file), timeout, std::forward<Handler>(handler))->step();
+}
+
+#endif // SENDFILE_HPP
@@ -0,0 +1,68 @@
+#ifndef SHARED_BUFFER_BODY_HPP
+#define SHARED_BUFFER_BODY_HPP
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace beast = boost::beast; // Namespace alias for Boost.Beast
+namespace http = beast::http;   // Namespace alias for Boost.Beast's HTTP module
+
+/**
+ * @brief A response body that sends an immutable buffer shared with other responses.
+ * 
+ * The body holds a reference on the buffer, so the same cached file contents can
+ * be written to any number of connections without copying them. Only the writer
+ * (serialization) side is provided.
+ */
+struct shared_buffer_body
+{
+    /// The shared, immutable contents of the body.
+    using value_type = std::shared_ptr<std::string const>;
+
+    /**
+     * @brief Returns the payload size of the body.
+     * 
+     * @param body The body to measure.
+     * @return The number of bytes in the body.
+     */
+    static std::uint64_t size(value_type const& body)
+    {
+        return body ? body->size() : 0;
+    }
+
+    /**
+     * @brief Serializer algorithm, yields the whole buffer in a single step.
+     */
+    class writer
+    {
+        value_type const& body_; ///< The body being serialized
+
+    public:
+        using const_buffers_type = boost::asio::const_buffer;
+
+        template<bool isRequest, class Fields>
+        writer(http::header<isRequest, Fields> const&, value_type const& body)
+            : body_(body)
+        {
+        }
+
+        void init(beast::error_code& ec)
+        {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec)
+        {
+            ec = {};
+            if(! body_ || body_->empty())
+                return boost::none;
+            return {{const_buffers_type(body_->data(), body_->size()), false}};
+        }
+    };
+};
+
+#endif // SHARED_BUFFER_BODY_HPP
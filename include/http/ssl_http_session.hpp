@@ -3,6 +3,9 @@
 
 #include "../util/beast.hpp"
 #include "../util/util.hpp"
+#include "../util/crypto_pool.hpp"
+#include "../util/tls_records.hpp"
+#include "../util/tls_resumption.hpp"
 #include "http_session.hpp"
 
 /**
@@ -17,7 +20,12 @@ class ssl_http_session
     : public http_session<ssl_http_session>
     , public std::enable_shared_from_this<ssl_http_session>
 {
+    std::shared_ptr<ssl::context> ctx_;     ///< The context the stream was created with, kept across reloads
     ssl::stream<beast::tcp_stream> stream_; ///< The SSL stream used for secure communication
+    std::chrono::steady_clock::time_point handshake_start_; ///< When the TLS handshake began
+    bool handshake_timed_out_ = false;      ///< Whether an offloaded handshake hit its deadline
+    bool handshake_done_ = false;           ///< Whether an offloaded handshake has completed
+    tls_records::sizer records_;            ///< Sizes the records of responses
 
 public:
     /**
@@ -28,16 +36,26 @@ public:
      * is moved and the SSL context is applied.
      * 
      * @param stream The TCP stream used for the connection, wrapped in an SSL stream.
-     * @param ctx The SSL context containing the server certificate and key.
+     * @param ctx The SSL context containing the server certificate and key, shared with
+     *            the other connections accepted before the next certificate reload.
      * @param buffer A buffer used for reading and writing data.
      * @param doc_root A shared pointer to the document root directory.
      */
-    ssl_http_session(beast::tcp_stream&& stream, ssl::context& ctx, beast::flat_buffer&& buffer, std::shared_ptr<std::string const> const& doc_root)
+    ssl_http_session(beast::tcp_stream&& stream, std::shared_ptr<ssl::context> ctx, beast::flat_buffer&& buffer, std::shared_ptr<std::string const> const& doc_root)
         : http_session<ssl_http_session>(std::move(buffer), doc_root),  // Pass buffer and doc_root to the base class
-          stream_(std::move(stream), ctx)  // Initialize the SSL stream
+          ctx_(std::move(ctx)),
+          stream_(std::move(stream), *ctx_)  // Initialize the SSL stream
     {
     }
 
+    /**
+     * @brief Keep the session resumable however the connection ended.
+     */
+    ~ssl_http_session()
+    {
+        tls_resumption::keep_resumable(stream_.native_handle());
+    }
+
     /**
      * @brief Start the SSL session.
      * 
@@ -46,6 +64,11 @@ public:
      */
     void run()
     {
+        handshake_start_ = std::chrono::steady_clock::now();
+
+        if(crypto_pool::instance().enabled())
+            return offload_handshake();
+
         // Set the timeout for the operation.
         beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
 
@@ -71,17 +94,46 @@ public:
         return stream_;
     }
 
+    /**
+     * @brief Check whether file bodies can be sent with sendfile(2).
+     * 
+     * Never possible here. Kernel TLS would let the kernel seal the records, but
+     * Asio's SSL stream drives OpenSSL through a memory BIO pair, so OpenSSL never
+     * switches it on. Installing the keys with TCP_ULP by hand would also need the
+     * record sequence numbers after the handshake, which OpenSSL does not export.
+     * File bodies therefore pass through the SSL stream, read on the file_io
+     * threads when that backend is enabled.
+     * 
+     * @return False.
+     */
+    bool can_sendfile() const
+    {
+        return false;
+    }
+
+    /**
+     * @brief Size the TLS records of the next response.
+     * 
+     * Called by the base class before each response is written: small records
+     * while the connection is new or has been idle, full-size ones afterwards.
+     */
+    void before_write()
+    {
+        records_.before_write(stream_.native_handle());
+    }
+
     /**
      * @brief Release the SSL stream.
      * 
      * This function moves and returns the SSL stream, transferring ownership.
      * It is typically called when the session is upgraded to a WebSocket connection.
+     * The context goes along, so the WebSocket session keeps it alive in turn.
      * 
-     * @return The SSL stream, moved out of the session.
+     * @return The SSL stream, moved out of the session, and its context.
      */
-    ssl::stream<beast::tcp_stream> release_stream()
+    released_ssl_stream release_stream()
     {
-        return std::move(stream_);
+        return {std::move(stream_), ctx_};
     }
 
     /**
@@ -104,6 +156,55 @@ public:
     }
 
 private:
+    /**
+     * @brief Run the handshake on a strand of the crypto pool.
+     * 
+     * Every step of the handshake, the initial one included, runs on the pool: the
+     * completions of the socket operations it starts are delivered to the strand the
+     * final handler is bound to. The tcp_stream timeout is replaced by a timer on the
+     * same strand, since its handler would otherwise run on the session's strand
+     * concurrently with the handshake. The result is handed back to the session's
+     * own strand. Cancelling the timer does not recall a completion already queued,
+     * so the timer leaves the socket alone once the handshake is done: by then the
+     * session's strand may have started reading from it.
+     */
+    void offload_handshake()
+    {
+        beast::get_lowest_layer(stream_).expires_never();
+        metrics::add(metrics::crypto_queue);
+
+        auto strand = crypto_pool::instance().make_strand();
+        net::post(strand, [self = shared_from_this(), strand]()
+        {
+            metrics::record(metrics::handshake_queue, std::chrono::steady_clock::now() - self->handshake_start_);
+
+            auto timer = std::make_shared<net::steady_timer>(strand, std::chrono::seconds(30));
+            timer->async_wait([self](beast::error_code ec)
+            {
+                if(ec || self->handshake_done_)
+                    return;
+                self->handshake_timed_out_ = true;
+                beast::get_lowest_layer(self->stream_).socket().cancel(ec);
+            });
+
+            self->stream_.async_handshake(
+                ssl::stream_base::server,
+                self->buffer_.data(),
+                net::bind_executor(strand, [self, timer](beast::error_code ec, std::size_t bytes_used)
+                {
+                    self->handshake_done_ = true;
+                    timer->cancel();
+                    metrics::add(metrics::crypto_queue, -1);
+                    if(self->handshake_timed_out_)
+                        ec = beast::error::timeout;
+
+                    net::dispatch(
+                        self->stream_.get_executor(),
+                        beast::bind_front_handler(&ssl_http_session::on_handshake, self, ec, bytes_used));
+                }));
+        });
+    }
+
     /**
      * @brief Handle the result of the SSL handshake.
      * 
@@ -118,9 +219,16 @@ private:
         if(ec)
             return fail(ec, "handshake");
 
+        metrics::record(metrics::tls_handshake, std::chrono::steady_clock::now() - handshake_start_);
+        metrics::add(SSL_session_reused(stream_.native_handle())
+            ? metrics::tls_resumed_handshakes : metrics::tls_full_handshakes);
+
         // Consume the portion of the buffer used by the handshake
         buffer_.consume(bytes_used);
 
+        // Start with records that fit in one segment when dynamic sizing is enabled.
+        records_.attach(stream_.native_handle(), beast::get_lowest_layer(stream_).socket().native_handle());
+
         // Start reading data
         do_read();
     }
@@ -0,0 +1,131 @@
+#ifndef VALIDATORS_HPP
+#define VALIDATORS_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Cache of the ETag and Last-Modified validators of static files.
+ *
+ * The first lookup of a file stats it and formats both validators; the result is
+ * kept until file_watcher reports a change to the file or its directory, or until
+ * it is the least recently used of too many, so revalidation requests are answered
+ * without touching the file system. Without inotify every lookup stats the file again.
+ */
+class validators
+{
+public:
+    /**
+     * @brief Validators of one version of a file.
+     */
+    struct entry
+    {
+        std::string etag;           ///< Quoted entity tag, "W/" prefixed when weak
+        std::string last_modified;  ///< Modification time as an HTTP date
+        std::time_t mtime = 0;      ///< Modification time, in seconds since the epoch
+        std::int64_t mtime_ns = 0;  ///< Modification time, in nanoseconds since the epoch
+        std::uint64_t size = 0;     ///< Size of the file
+    };
+
+    using entry_type = std::shared_ptr<entry const>;
+
+    /**
+     * @brief Access the shared cache instance.
+     *
+     * @return A reference to the process-wide cache.
+     */
+    static validators& instance();
+
+    /**
+     * @brief Choose the kind of entity tag issued and bound the cache.
+     *
+     * Must be called before the I/O threads start serving requests.
+     *
+     * @param weak True to issue weak tags, false (the default) for strong ones.
+     * @param capacity The maximum number of files whose validators are kept.
+     */
+    void configure(bool weak, std::size_t capacity);
+
+    /**
+     * @brief Get the validators of a file.
+     *
+     * @param path The path of the file.
+     * @return The validators, or null if the path is not a regular file.
+     */
+    entry_type lookup(std::string const& path);
+
+    /**
+     * @brief Derive the tag of a representation produced from the file.
+     *
+     * @param etag The tag of the file.
+     * @param coding The Content-Encoding token of the representation, or null for the file itself.
+     * @return The tag, with the coding appended inside the quotes.
+     */
+    static std::string tag(std::string const& etag, char const* coding);
+
+    /**
+     * @brief Evaluate an If-None-Match header value with the weak comparison.
+     *
+     * @param header The header value, "*" or a list of entity tags.
+     * @param etag The current tag of the representation.
+     * @return True if one of the listed tags matches.
+     */
+    static bool none_match(std::string_view header, std::string_view etag);
+
+    /**
+     * @brief Compare two entity tags with the strong comparison, as If-Range requires.
+     *
+     * @return True if both are strong and identical.
+     */
+    static bool strong_match(std::string_view a, std::string_view b);
+
+private:
+    validators();
+
+    /**
+     * @brief Drop cached validators for a changed path.
+     *
+     * @param path A file, a directory (drops every file in it), or an empty string for all.
+     */
+    void invalidate(std::string const& path);
+
+    /**
+     * @brief Cached validators of one path.
+     */
+    struct slot
+    {
+        entry_type value;                       ///< The validators
+        std::list<std::string>::iterator lru;   ///< Position in the recency list
+    };
+
+    /**
+     * @brief Remove a cached path, from its directory's list too. Must be called with mutex_ held.
+     */
+    void erase(std::unordered_map<std::string, slot>::iterator it);
+
+    /**
+     * @brief Stat a file and format its validators.
+     *
+     * @param path The path of the file.
+     * @return The validators, or null if the path is not a regular file.
+     */
+    entry_type probe(std::string const& path) const;
+
+    bool enabled_ = false;                                                  ///< Whether inotify is available
+    bool weak_ = false;                                                     ///< Whether tags are issued weak
+    std::size_t capacity_ = 10000;                                          ///< Maximum number of cached paths
+    std::mutex mutex_;                                                      ///< Protects the members below
+    std::uint64_t generation_ = 0;                                          ///< Bumped on every invalidation
+    std::list<std::string> lru_;                                            ///< Cached paths, most recently used first
+    std::unordered_map<std::string, slot> entries_;                         ///< Validators by path
+    std::unordered_map<std::string, std::vector<std::string>> directories_; ///< Cached paths by directory
+};
+
+#endif // VALIDATORS_HPP
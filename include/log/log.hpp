@@ -1,6 +1,8 @@
 #ifndef LOG_HPP
 #define LOG_HPP
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
 #include <memory>
@@ -9,6 +11,9 @@
 #include <map>
 #include <sstream>
 
+/// Descriptor written by the asynchronous backend, closed once nothing refers to it
+struct LogDescriptor;
+
 /// Enum representing the log level severity
 enum class LogLevel {
     DEBUG,  ///< Detailed debug information
@@ -17,6 +22,34 @@ enum class LogLevel {
     ERROR   ///< Errors that require attention
 };
 
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+/// Lowest level compiled into the binary (0=DEBUG .. 3=ERROR), set with -DLOG_MIN_LEVEL
+constexpr LogLevel kMinLogLevel = static_cast<LogLevel>(LOG_MIN_LEVEL);
+
+/**
+ * @brief Logs a message built from the remaining arguments, formatted only if enabled.
+ *
+ * Statements below kMinLogLevel are discarded at compile time and their arguments
+ * are never evaluated; otherwise the arguments are only streamed into a message
+ * after the logger's runtime level check passes.
+ * Example: LOG_DEBUG(logger, "Loading file content from: ", file_path);
+ */
+#define LOG_AT(logger, level, ...)                                  \
+    do {                                                            \
+        if constexpr ((level) >= kMinLogLevel) {                    \
+            if ((logger)->isEnabled(level))                         \
+                (logger)->logf((level), __VA_ARGS__);               \
+        }                                                           \
+    } while (0)
+
+#define LOG_DEBUG(logger, ...) LOG_AT(logger, LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_INFO(logger, ...)  LOG_AT(logger, LogLevel::INFO, __VA_ARGS__)
+#define LOG_WARN(logger, ...)  LOG_AT(logger, LogLevel::WARN, __VA_ARGS__)
+#define LOG_ERROR(logger, ...) LOG_AT(logger, LogLevel::ERROR, __VA_ARGS__)
+
 /// Enum representing the log output destination
 enum class LogOutput {
     CONSOLE, ///< Log to console
@@ -47,6 +80,43 @@ public:
      */
     void log(LogLevel level, const std::string& message);
 
+    /**
+     * @brief Writes preformatted text as-is, without timestamp or level prefix.
+     *
+     * Used for batched structured output such as access logs; the text should end
+     * with a newline.
+     * @param text The text to write.
+     */
+    void writeRaw(std::string text);
+
+    /**
+     * @brief Checks whether a message at the given level would be logged.
+     * @param level The level to check.
+     * @return True if the level passes both the compile-time and runtime filters.
+     */
+    bool isEnabled(LogLevel level) const {
+        return level >= kMinLogLevel && level >= level_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Logs a message built by streaming all arguments, if the level is enabled.
+     *
+     * Prefer the LOG_* macros, which also skip evaluating the arguments.
+     * @param level The level of the log message.
+     * @param args The values to stream into the message.
+     */
+    template<typename... Args>
+    void logf(LogLevel level, const Args&... args) {
+        if (!isEnabled(level)) {
+            return;
+        }
+        std::ostringstream& buffer = formatBuffer();
+        buffer.str("");
+        buffer.clear();
+        (buffer << ... << args);
+        log(level, buffer.str());
+    }
+
     /**
      * @brief Sets the logging level.
      * @param level The log level to set.
@@ -59,16 +129,29 @@ public:
      * @param filename The filename for file output (optional).
      */
     void setOutput(LogOutput output, const std::string& filename = "");
+
+    /**
+     * @brief Switches between synchronous and asynchronous output.
+     *
+     * In asynchronous mode messages are pushed into a lock-free queue and formatted
+     * and written in batches by a background thread, so the caller never blocks on
+     * the console or disk. Messages are dropped (and counted) if the queue is full.
+     * @param async True to enable asynchronous output.
+     */
+    void setAsync(bool async);
     
     /**
      * @brief Operator overload for streaming messages into the logger.
+     *
+     * Fragments are collected in a buffer owned by the calling thread, so streaming
+     * takes no lock and concurrent messages never interleave; the message is committed
+     * as a whole by std::endl.
      * @param message The message to log.
      * @return A reference to the Logger instance.
      */
     template<typename T>
     Logger& operator<<(const T& message) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        buffer_ << message;
+        threadBuffer() << message;
         return *this;
     }
 
@@ -81,11 +164,16 @@ public:
 
 private:
     std::string name_;                ///< The name of the logger
-    LogLevel level_;                  ///< Current log level
+    std::atomic<LogLevel> level_;     ///< Current log level
     LogOutput output_;                ///< Current output destination
     std::ofstream file_;              ///< File stream for file logging
+    std::string filename_;            ///< Path of the log file, if any
+    std::atomic<std::shared_ptr<const LogDescriptor>> fd_; ///< Descriptor used for asynchronous output
+    std::atomic<bool> async_{false};  ///< Whether output goes through the background writer
     std::mutex mutex_;                ///< Mutex to protect shared resources
-    std::ostringstream buffer_;       ///< Buffer for building log messages
+    std::uint64_t id_;                ///< Unique for the process lifetime, unlike the address
+
+    static std::atomic<std::uint64_t> nextId_;  ///< Next logger id
 
     /**
      * @brief Converts a LogLevel enum to its corresponding string representation.
@@ -99,6 +187,24 @@ private:
      * @param message The message to log.
      */
     void writeToOutput(const std::string& message);
+
+    /**
+     * @brief Returns the calling thread's buffer for messages streamed into this logger.
+     * @return The thread-local message buffer.
+     */
+    std::ostringstream& threadBuffer();
+
+    /**
+     * @brief Returns the calling thread's scratch buffer for logf().
+     * @return The thread-local formatting buffer.
+     */
+    static std::ostringstream& formatBuffer();
+
+    /**
+     * @brief Opens or selects the descriptor used for asynchronous output.
+     * Must be called with mutex_ held.
+     */
+    void openAsyncOutput();
 };
 
 /// LoggerManager class for managing multiple Logger instances
@@ -114,8 +220,15 @@ public:
      */
     static std::shared_ptr<Logger> getLogger(const std::string& name, LogLevel level = LogLevel::INFO, LogOutput output = LogOutput::CONSOLE, const std::string& filename = "");
 
+    /**
+     * @brief Switches all existing and future loggers to asynchronous or synchronous output.
+     * @param async True to enable asynchronous output.
+     */
+    static void setAsync(bool async);
+
 private:
     static std::mutex mutex_;                                           ///< Mutex to protect logger map
+    static bool async_;                                                 ///< Output mode for new loggers
     static std::map<std::string, std::shared_ptr<Logger>> loggers_;    ///< Map of loggers by name
 };
 
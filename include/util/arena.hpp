@@ -0,0 +1,162 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+ * @brief A recycling bump allocator owned by a single session.
+ *
+ * Memory is carved from a list of blocks; deallocation is a no-op except for the
+ * most recent allocation, which is rolled back so growing strings reuse their space.
+ * reset() makes every block available again without returning it to the heap, so
+ * once the arena has grown to fit the largest request it serves, later requests
+ * allocate nothing. Not thread-safe; everything allocated from it must be destroyed
+ * before reset().
+ */
+class arena
+{
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param block_size The size of the first block; later blocks double in size.
+     */
+    explicit arena(std::size_t block_size = 4096)
+    {
+        add_block(block_size);
+    }
+
+    arena(arena const&) = delete;
+    arena& operator=(arena const&) = delete;
+
+    /**
+     * @brief Allocate memory.
+     *
+     * @param size The number of bytes.
+     * @param align The required alignment, at most alignof(std::max_align_t).
+     * @return The memory.
+     */
+    void* allocate(std::size_t size, std::size_t align)
+    {
+        for(;;)
+        {
+            auto& b = blocks_[current_];
+            auto const start = (used_ + align - 1) & ~(align - 1);
+            if(start + size <= b.size)
+            {
+                last_ = start;
+                used_ = start + size;
+                return b.data.get() + start;
+            }
+
+            // Move on to the next retained block, or grow.
+            if(++current_ == blocks_.size())
+                add_block(std::max(blocks_.back().size * 2, size + align));
+            used_ = 0;
+        }
+    }
+
+    /**
+     * @brief Release memory, reclaiming it only if it was the latest allocation.
+     *
+     * @param p The memory returned by allocate().
+     * @param size The size that was requested.
+     */
+    void deallocate(void* p, std::size_t size) noexcept
+    {
+        auto& b = blocks_[current_];
+        if(static_cast<std::byte*>(p) == b.data.get() + last_ && last_ + size == used_)
+            used_ = last_;
+    }
+
+    /**
+     * @brief Make all memory available again, keeping the blocks.
+     */
+    void reset() noexcept
+    {
+        current_ = 0;
+        used_ = 0;
+        last_ = 0;
+    }
+
+private:
+    struct block
+    {
+        std::unique_ptr<std::byte[]> data;  ///< The memory
+        std::size_t size;                   ///< Its size in bytes
+    };
+
+    void add_block(std::size_t size)
+    {
+        blocks_.push_back({std::unique_ptr<std::byte[]>(new std::byte[size]), size});
+    }
+
+    std::vector<block> blocks_;     ///< Blocks, in allocation order
+    std::size_t current_ = 0;       ///< Block being carved from
+    std::size_t used_ = 0;          ///< Bytes used in the current block
+    std::size_t last_ = 0;          ///< Offset of the latest allocation in the current block
+};
+
+/**
+ * @brief Standard allocator adaptor for arena.
+ *
+ * A default-constructed allocator has no arena and uses the global heap, so containers
+ * built without one still work.
+ *
+ * @tparam T The value type.
+ */
+template<class T>
+class arena_allocator
+{
+    template<class U> friend class arena_allocator;
+
+    arena* arena_ = nullptr;    ///< The backing arena, null for the global heap
+
+public:
+    using value_type = T;
+
+    arena_allocator() noexcept = default;
+
+    explicit arena_allocator(arena& a) noexcept
+        : arena_(&a)
+    {
+    }
+
+    template<class U>
+    arena_allocator(arena_allocator<U> const& other) noexcept
+        : arena_(other.arena_)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if(! arena_)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if(! arena_)
+            return ::operator delete(p);
+        arena_->deallocate(p, n * sizeof(T));
+    }
+
+    template<class U>
+    bool operator==(arena_allocator<U> const& other) const noexcept
+    {
+        return arena_ == other.arena_;
+    }
+
+    template<class U>
+    bool operator!=(arena_allocator<U> const& other) const noexcept
+    {
+        return arena_ != other.arena_;
+    }
+};
+
+#endif // ARENA_HPP
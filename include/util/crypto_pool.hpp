@@ -0,0 +1,68 @@
+#ifndef CRYPTO_POOL_HPP
+#define CRYPTO_POOL_HPP
+
+#include "beast.hpp"
+#include <boost/asio/thread_pool.hpp>
+#include <cstddef>
+#include <memory>
+
+/**
+ * @brief Bounded thread pool that runs TLS handshakes away from the I/O threads.
+ *
+ * The private-key and key-exchange work of a handshake is expensive, so during a
+ * reconnect storm it would otherwise delay every established connection served by
+ * the same I/O thread. Handshakes are queued on a fixed number of threads instead;
+ * established connections never run on them. The pool is disabled until configure()
+ * is called with a non-zero thread count.
+ */
+class crypto_pool
+{
+public:
+    /**
+     * @brief Access the shared pool instance.
+     *
+     * @return A reference to the process-wide pool.
+     */
+    static crypto_pool& instance();
+
+    /**
+     * @brief Start the crypto threads.
+     *
+     * Must be called before the I/O threads start accepting connections.
+     *
+     * @param threads The number of crypto threads, 0 to keep handshakes on the I/O threads.
+     */
+    void configure(std::size_t threads);
+
+    /**
+     * @brief Check whether handshakes are offloaded.
+     *
+     * @return True if configure() was called with a non-zero thread count.
+     */
+    bool enabled() const
+    {
+        return pool_ != nullptr;
+    }
+
+    /**
+     * @brief Get a new strand on the pool, to serialize the steps of one handshake.
+     *
+     * @return The strand.
+     */
+    net::strand<net::thread_pool::executor_type> make_strand()
+    {
+        return net::make_strand(pool_->get_executor());
+    }
+
+    crypto_pool(crypto_pool const&) = delete;
+    crypto_pool& operator=(crypto_pool const&) = delete;
+
+    ~crypto_pool();
+
+private:
+    crypto_pool() = default;
+
+    std::unique_ptr<net::thread_pool> pool_;    ///< The crypto threads, null when disabled
+};
+
+#endif // CRYPTO_POOL_HPP
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2024 Diyor Sattarov
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Process-wide inotify watcher used to invalidate cached file data.
+ * 
+ * Watches are one-shot: the first change to a watched file notifies every
+ * subscriber with the path and drops the watch, so a cache only has to call
+ * watch() again when it reloads the file. A background thread reads the
+ * inotify descriptor; subscribers are called on that thread.
+ * 
+ * The number of watched paths is bounded. Watching one more than the limit
+ * drops the least recently watched path, and subscribers are notified of it as
+ * if it had changed, on the thread that called watch(). Pinned paths are never
+ * dropped and do not count towards the limit.
+ */
+class file_watcher
+{
+public:
+    /**
+     * @brief Callback invoked when a watched file changes.
+     * 
+     * An empty path means events were lost and every watched file must be
+     * treated as changed.
+     */
+    using callback = std::function<void(std::string const& path)>;
+
+    /**
+     * @brief Access the shared watcher instance.
+     * 
+     * @return A reference to the process-wide watcher.
+     */
+    static file_watcher& instance();
+
+    /**
+     * @brief Check whether inotify could be initialized.
+     * 
+     * @return True if watch() can succeed.
+     */
+    bool available() const;
+
+    /**
+     * @brief Bound the number of watched paths.
+     * 
+     * Must be called before the I/O threads start serving requests.
+     * 
+     * @param capacity The maximum number of paths watched at once.
+     */
+    void configure(std::size_t capacity);
+
+    /**
+     * @brief Watch a file until its next modification, removal or rename.
+     * 
+     * A directory is watched until an entry is created in or moved into it.
+     * 
+     * @param path The path of the file or directory to watch.
+     * @param pinned Whether the watch is exempt from the limit, for the few paths
+     *        whose subscribers act on every notification.
+     * @return True if the watch was installed.
+     */
+    bool watch(std::string const& path, bool pinned = false);
+
+    /**
+     * @brief Register a callback for change notifications.
+     * 
+     * @param cb The callback to invoke on the watcher thread.
+     */
+    void subscribe(callback cb);
+
+    file_watcher(file_watcher const&) = delete;
+    file_watcher& operator=(file_watcher const&) = delete;
+
+    ~file_watcher();
+
+private:
+    file_watcher();
+
+    /**
+     * @brief Event loop run by the watcher thread.
+     */
+    void run();
+
+    /**
+     * @brief Invoke all subscribers for a changed path.
+     * 
+     * @param path The changed path, or an empty string for all paths.
+     */
+    void notify(std::string const& path);
+
+    /**
+     * @brief Forget a watched path, removing its watch if no other path uses it.
+     * 
+     * Must be called with mutex_ held.
+     */
+    void forget(std::string const& path);
+
+    /**
+     * @brief A watched path and its watch descriptor.
+     */
+    struct watched
+    {
+        int wd;                                 ///< The watch descriptor
+        std::list<std::string>::iterator lru;   ///< Position in the recency list, unused if pinned
+        bool pinned = false;                    ///< Whether the path is exempt from the limit
+    };
+
+    int fd_ = -1;                                               ///< The inotify descriptor
+    int stop_fd_ = -1;                                          ///< eventfd used to wake the thread on shutdown
+    std::thread thread_;                                        ///< Thread reading inotify events
+    std::size_t capacity_ = 65536;                              ///< Maximum number of watched paths
+    std::mutex mutex_;                                          ///< Protects the members below
+    std::unordered_map<int, std::vector<std::string>> paths_;   ///< Watched paths by watch descriptor
+    std::unordered_map<std::string, watched> watched_;          ///< Watch descriptors by path
+    std::list<std::string> lru_;                                ///< Unpinned watched paths, most recently watched first
+    std::vector<callback> callbacks_;                           ///< Registered subscribers
+};
+
+#endif // FILE_WATCHER_HPP
@@ -0,0 +1,135 @@
+#ifndef HDR_HISTOGRAM_HPP
+#define HDR_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief High-dynamic-range histogram of integer values, such as latencies in microseconds.
+ *
+ * Values below 128 are counted exactly; above that every power of two is split into
+ * 64 linear sub-buckets, so any recorded value is reported within 1/64 (about 1.6%)
+ * of its true value up to 2^41 (about 25 days in microseconds). Larger values are
+ * clamped. Recording is a single relaxed store and is meant for one writing thread;
+ * other threads may read the counts at any time and merge several histograms into
+ * a snapshot.
+ */
+class hdr_histogram
+{
+public:
+    static constexpr unsigned sub_bucket_bits = 7;                          ///< Bits of precision kept per value
+    static constexpr std::uint64_t sub_bucket_count = 1u << sub_bucket_bits; ///< Values below this are exact
+    static constexpr unsigned max_magnitude = 40;                           ///< Highest power of two tracked
+    static constexpr std::size_t bucket_count =
+        sub_bucket_count + (max_magnitude - sub_bucket_bits + 1) * (sub_bucket_count / 2);
+
+    using snapshot = std::array<std::uint64_t, bucket_count>;
+
+    /**
+     * @brief Count one value. Only the owning thread may call this.
+     *
+     * @param value The value to record.
+     */
+    void record(std::uint64_t value)
+    {
+        auto& count = counts_[index_of(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Add the current counts to a snapshot.
+     *
+     * @param out The snapshot to merge into.
+     */
+    void add_to(snapshot& out) const
+    {
+        for(std::size_t i = 0; i < bucket_count; ++i)
+            out[i] += counts_[i].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the bucket a value is counted in.
+     *
+     * @param value The value.
+     * @return The bucket index.
+     */
+    static std::size_t index_of(std::uint64_t value)
+    {
+        if(value < sub_bucket_count)
+            return static_cast<std::size_t>(value);
+
+        constexpr std::uint64_t max_value = (std::uint64_t{2} << max_magnitude) - 1;
+        if(value > max_value)
+            value = max_value;
+
+        unsigned const magnitude = 63 - static_cast<unsigned>(__builtin_clzll(value));
+        unsigned const shift = magnitude - (sub_bucket_bits - 1);
+        auto const sub = (value >> shift) - sub_bucket_count / 2;
+        return static_cast<std::size_t>(
+            sub_bucket_count + (magnitude - sub_bucket_bits) * (sub_bucket_count / 2) + sub);
+    }
+
+    /**
+     * @brief Get the largest value counted in a bucket.
+     *
+     * @param index The bucket index.
+     * @return The highest value that maps to the bucket.
+     */
+    static std::uint64_t highest_equivalent(std::size_t index)
+    {
+        if(index < sub_bucket_count)
+            return index;
+
+        auto const k = index - sub_bucket_count;
+        unsigned const magnitude = sub_bucket_bits + static_cast<unsigned>(k / (sub_bucket_count / 2));
+        auto const sub = sub_bucket_count / 2 + k % (sub_bucket_count / 2);
+        unsigned const shift = magnitude - (sub_bucket_bits - 1);
+        return ((sub + 1) << shift) - 1;
+    }
+
+    /**
+     * @brief Get the total number of values in a snapshot.
+     */
+    static std::uint64_t total(snapshot const& counts)
+    {
+        std::uint64_t n = 0;
+        for(auto c : counts)
+            n += c;
+        return n;
+    }
+
+    /**
+     * @brief Get the value at a quantile of a snapshot.
+     *
+     * @param counts The snapshot.
+     * @param q The quantile, between 0 and 1; 1 yields the maximum.
+     * @return The highest equivalent value of the bucket holding the quantile, 0 if empty.
+     */
+    static std::uint64_t value_at_quantile(snapshot const& counts, double q)
+    {
+        auto const n = total(counts);
+        if(n == 0)
+            return 0;
+
+        auto rank = static_cast<std::uint64_t>(q * static_cast<double>(n) + 0.5);
+        if(rank < 1)
+            rank = 1;
+        if(rank > n)
+            rank = n;
+
+        std::uint64_t seen = 0;
+        for(std::size_t i = 0; i < bucket_count; ++i)
+        {
+            seen += counts[i];
+            if(seen >= rank)
+                return highest_equivalent(i);
+        }
+        return highest_equivalent(bucket_count - 1);
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> counts_{}; ///< Count per bucket
+};
+
+#endif // HDR_HISTOGRAM_HPP
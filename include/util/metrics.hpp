@@ -0,0 +1,166 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include "hdr_histogram.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Process-wide runtime counters, exported in the Prometheus text format.
+ *
+ * Every thread updates its own cache-line-aligned shard with plain relaxed stores,
+ * so recording a metric never contends with other I/O threads. Shards are only
+ * summed when the metrics are rendered for a scrape. Gauges such as active sessions
+ * are kept as signed counters that are incremented and decremented, possibly on
+ * different threads; their sum over all shards is the current value.
+ */
+class metrics
+{
+public:
+    /**
+     * @brief The recorded counters and gauges.
+     */
+    enum counter : std::size_t
+    {
+        accepts,                ///< Accepted TCP connections
+        tls_detected,           ///< Connections detected as TLS
+        plain_detected,         ///< Connections detected as plain HTTP
+        http_sessions,          ///< Active HTTP sessions (gauge)
+        websocket_sessions,     ///< Active WebSocket sessions (gauge)
+        queued_responses,       ///< Responses waiting in session pipelines (gauge)
+        requests,               ///< HTTP requests handled
+        bytes_in,               ///< HTTP and WebSocket payload bytes read
+        bytes_out,              ///< HTTP and WebSocket payload bytes written
+        tls_full_handshakes,    ///< TLS handshakes that negotiated a new session
+        tls_resumed_handshakes, ///< TLS handshakes that resumed a session
+        tls_cache_hits,         ///< Session IDs found in the server-side session cache
+        tls_cache_misses,       ///< Session IDs not found in the server-side session cache
+        tls_ticket_hits,        ///< Session tickets opened with a known key
+        tls_ticket_misses,      ///< Session tickets sealed with an unknown or expired key
+        crypto_queue,           ///< TLS handshakes queued or running on the crypto pool (gauge)
+        tls_reloads,            ///< SSL contexts rebuilt and published after startup
+        tls_reload_failures,    ///< SSL context rebuilds that failed, keeping the current one
+        counter_count
+    };
+
+    /**
+     * @brief Pipeline stages with their own high-dynamic-range latency histogram.
+     */
+    enum stage : std::size_t
+    {
+        accept_to_detect,       ///< From accepting a connection to detecting TLS or plain HTTP
+        detect_to_first_byte,   ///< From detection to the first byte of the first request
+        handshake_queue,        ///< From queueing a TLS handshake on the crypto pool to its start
+        tls_handshake,          ///< The TLS handshake
+        parse,                  ///< Reading and parsing a request
+        handle,                 ///< handle_request
+        write,                  ///< Writing a response
+        stage_count
+    };
+
+    /**
+     * @brief Upper bounds of the request latency histogram buckets, in microseconds.
+     */
+    static constexpr std::array<std::uint64_t, 14> latency_bounds_us{
+        100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+        100000, 250000, 500000, 1000000, 2500000};
+
+    /**
+     * @brief Add to a counter of the calling thread's shard.
+     *
+     * @param c The counter.
+     * @param n The amount, negative to decrement a gauge.
+     */
+    static void add(counter c, std::int64_t n = 1)
+    {
+        auto& value = local().counters[c];
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record the latency of a completed request.
+     *
+     * @param latency The time from the first request byte to the last response byte.
+     */
+    static void observe_latency(std::chrono::steady_clock::duration latency);
+
+    /**
+     * @brief Record how long a pipeline stage took, in the calling thread's shard.
+     *
+     * @param s The stage.
+     * @param elapsed The duration of the stage.
+     */
+    static void record(stage s, std::chrono::steady_clock::duration elapsed)
+    {
+        auto const us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        local().stages[s].record(us > 0 ? static_cast<std::uint64_t>(us) : 0);
+    }
+
+    /**
+     * @brief Sum all shards and format them for a scrape.
+     *
+     * @return The metrics in the Prometheus text exposition format.
+     */
+    static std::string render();
+
+    /**
+     * @brief Merge the stage histograms of all shards into a readable table.
+     *
+     * Runs concurrently with the I/O threads, which keep recording while it reads.
+     *
+     * @return One line per stage with its count and latency percentiles in microseconds.
+     */
+    static std::string render_stages();
+
+private:
+    /**
+     * @brief The counters owned by one thread, aligned so that shards never share a cache line.
+     */
+    struct alignas(64) shard
+    {
+        std::array<std::atomic<std::int64_t>, counter_count> counters{};                      ///< Counter values
+        std::array<std::atomic<std::uint64_t>, latency_bounds_us.size() + 1> latency_buckets{}; ///< Non-cumulative bucket counts, last is +Inf
+        std::atomic<std::uint64_t> latency_sum_us{0};                                          ///< Sum of observed latencies
+        std::array<hdr_histogram, stage_count> stages;                                         ///< Per-stage latencies in microseconds
+    };
+
+    /**
+     * @brief Get the calling thread's shard, registering it on first use.
+     */
+    static shard& local()
+    {
+        thread_local shard* mine = register_shard();
+        return *mine;
+    }
+
+    /**
+     * @brief Allocate a shard and add it to the registry.
+     *
+     * Shards are kept after their thread exits so that totals never go backwards.
+     */
+    static shard* register_shard();
+
+    /**
+     * @brief Merge the histograms of one stage over all shards.
+     */
+    static hdr_histogram::snapshot merge(stage s);
+
+    /**
+     * @brief Every shard ever registered, guarded by its mutex.
+     */
+    struct registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<shard>> shards;
+    };
+
+    static registry& shards();
+};
+
+#endif // METRICS_HPP
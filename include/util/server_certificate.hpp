@@ -38,6 +38,22 @@
  */
 std::string load_file_content(const std::string& file_path);
 
+/**
+ * @brief Configure a server SSL context with a certificate, its private key, and DH parameters.
+ * 
+ * Applies the options shared by every server context, so contexts selected by SNI
+ * behave like the default one.
+ * 
+ * @param ctx The SSL context to configure.
+ * @param cert The PEM certificate chain.
+ * @param key The PEM private key.
+ * @param dh The PEM DH parameters.
+ * @param password The password of the private key.
+ * @throws boost::system::system_error if OpenSSL rejects one of them.
+ */
+void configure_server_context(boost::asio::ssl::context& ctx, const std::string& cert, const std::string& key,
+                              const std::string& dh, const std::string& password);
+
 /**
  * @brief Load the server certificate, private key, and DH parameters into the SSL context.
  * 
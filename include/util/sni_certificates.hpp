@@ -0,0 +1,78 @@
+#ifndef SNI_CERTIFICATES_HPP
+#define SNI_CERTIFICATES_HPP
+
+#include <boost/asio/ssl/context.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Certificates selected by the TLS server name (SNI), one prebuilt context each.
+ *
+ * Every "<name>.crt" file of a directory with a matching "<name>.key" gets its own
+ * SSL context, configured like the default one. The DNS names of the certificate's
+ * subjectAltName extension (or its common name, without one) are indexed in two hash
+ * tables: exact names, and the parent domains of "*." wildcards. Choosing a
+ * certificate is then at most two lookups, however many hostnames are served. Names
+ * that match nothing keep the default context. Each instance belongs to one
+ * default context, so a reloaded context comes with its own certificates.
+ */
+class sni_certificates
+{
+public:
+    sni_certificates() = default;
+
+    /**
+     * @brief Load the certificates of a directory and select them on the default context.
+     *
+     * Must be called before the default context accepts connections, and this
+     * object must outlive it.
+     *
+     * @param directory The directory holding "<name>.crt" and "<name>.key" pairs.
+     * @param dh The PEM DH parameters used by every context.
+     * @param password The password of the private keys.
+     * @param default_ctx The context connections start with; its session cache and ticket keys are shared.
+     * @return The number of certificates loaded.
+     * @throws std::runtime_error if the directory cannot be read or a certificate cannot be loaded.
+     */
+    std::size_t load(std::string const& directory, std::string const& dh, std::string const& password,
+                     boost::asio::ssl::context& default_ctx);
+
+    /**
+     * @brief Find the context for a server name.
+     *
+     * @param name The server name sent by the client, in any case.
+     * @return The context, or null to keep the default one.
+     */
+    SSL_CTX* find(std::string_view name) const;
+
+    sni_certificates(sni_certificates const&) = delete;
+    sni_certificates& operator=(sni_certificates const&) = delete;
+
+private:
+    /**
+     * @brief Index the DNS names of a context's certificate.
+     *
+     * @param ctx The context.
+     * @return The number of names indexed.
+     */
+    std::size_t index(SSL_CTX* ctx);
+
+    /**
+     * @brief Add one name, "*.example.com" for a wildcard, to the tables.
+     */
+    void add(std::string name, SSL_CTX* ctx);
+
+    /**
+     * @brief OpenSSL callback switching the connection to the context of its server name.
+     */
+    static int on_servername(SSL* ssl, int* alert, void* arg);
+
+    std::vector<std::unique_ptr<boost::asio::ssl::context>> contexts_;  ///< Owns the loaded contexts
+    std::unordered_map<std::string, SSL_CTX*> exact_;                   ///< Contexts by lowercase host name
+    std::unordered_map<std::string, SSL_CTX*> wildcard_;                ///< Contexts by parent domain of a wildcard
+};
+
+#endif // SNI_CERTIFICATES_HPP
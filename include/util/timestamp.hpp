@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2024 Diyor Sattarov
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TIMESTAMP_HPP
+#define TIMESTAMP_HPP
+
+#include <chrono>
+#include <ctime>
+#include <string_view>
+
+/**
+ * @brief Cached, second-resolution timestamp formatting.
+ * 
+ * Each thread keeps its own preformatted strings and only calls localtime_r or
+ * gmtime_r when the second changes, so formatting a timestamp is normally a
+ * comparison and, for microseconds, six digits written in place. Returned views
+ * point into thread-local storage and stay valid until the next call of the same
+ * function on the same thread.
+ */
+class timestamp
+{
+public:
+    using clock = std::chrono::system_clock;
+
+    /**
+     * @brief Format a time as local "YYYY-mm-dd HH:MM:SS".
+     * 
+     * @param tp The time to format.
+     * @return The formatted timestamp.
+     */
+    static std::string_view local(clock::time_point tp = clock::now());
+
+    /**
+     * @brief Format a time as local "YYYY-mm-dd HH:MM:SS.uuuuuu".
+     * 
+     * @param tp The time to format.
+     * @return The formatted timestamp.
+     */
+    static std::string_view local_micros(clock::time_point tp = clock::now());
+
+    /**
+     * @brief Format a time as an HTTP date (RFC 7231 IMF-fixdate, always GMT).
+     * 
+     * @param tp The time to format.
+     * @return The formatted date, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+     */
+    static std::string_view http_date(clock::time_point tp = clock::now());
+
+    /**
+     * @brief Parse an HTTP date in the IMF-fixdate format.
+     * 
+     * @param text The date, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+     * @param sec Receives the time in seconds since the epoch.
+     * @return True if the text is a valid IMF-fixdate.
+     */
+    static bool parse_http_date(std::string_view text, std::time_t& sec);
+};
+
+#endif // TIMESTAMP_HPP
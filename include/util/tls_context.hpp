@@ -0,0 +1,121 @@
+#ifndef TLS_CONTEXT_HPP
+#define TLS_CONTEXT_HPP
+
+#include "beast.hpp"
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The server's current SSL context, rebuilt and swapped without a restart.
+ *
+ * The context is published through an atomic shared pointer: the listener loads it
+ * once per accepted connection, and each TLS session keeps a reference to the
+ * context it started with. A reload builds a complete new context on a dedicated
+ * thread, certificates, SNI table and resumption callbacks included, then swaps it
+ * in. Handshakes from then on use the new one; established connections, WebSocket
+ * ones included, keep theirs until they close. If the build fails, the error is
+ * logged and the current context stays in place.
+ *
+ * Reloads are requested with reload(), typically from a SIGHUP handler, or by
+ * changes to the watched certificate files when inotify is available. Their
+ * watches are pinned, so static file traffic never evicts them. A notification
+ * only rebuilds the context if a watched path's stat data changed, since inotify
+ * also reports lost events without naming the files.
+ */
+class tls_context
+{
+public:
+    /**
+     * @brief Builds a fully configured server context. May throw.
+     */
+    using builder = std::function<std::shared_ptr<ssl::context>()>;
+
+    /**
+     * @brief Access the shared instance.
+     *
+     * @return A reference to the process-wide instance.
+     */
+    static tls_context& instance();
+
+    /**
+     * @brief Build the first context and start the reload thread.
+     *
+     * Must be called before the I/O threads start accepting connections. The first
+     * build runs on the calling thread, so its errors propagate.
+     *
+     * @param build The function building a context, called again on every reload.
+     * @param watched Files and directories whose changes trigger a reload.
+     */
+    void configure(builder build, std::vector<std::string> watched);
+
+    /**
+     * @brief Get the context for a new connection.
+     *
+     * @return The most recently published context.
+     */
+    std::shared_ptr<ssl::context> current() const
+    {
+        return current_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Rebuild the context on the reload thread, whether or not the files changed.
+     *
+     * Requests made while one is pending are merged into it.
+     *
+     * @param delay How long to wait first, letting related file changes settle.
+     */
+    void reload(std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+
+    tls_context(tls_context const&) = delete;
+    tls_context& operator=(tls_context const&) = delete;
+
+    ~tls_context();
+
+private:
+    tls_context() = default;
+
+    /**
+     * @brief Schedule a rebuild on the reload thread, merged with a pending one.
+     *
+     * @param delay How long to wait first.
+     */
+    void schedule(std::chrono::milliseconds delay);
+
+    /**
+     * @brief Watch the configured paths until their next change.
+     */
+    void watch();
+
+    /**
+     * @brief Describe the watched paths as they are on disk now.
+     *
+     * @return Device, inode, size, mtime and ctime of each path, zeros if it is missing.
+     */
+    std::vector<std::uint64_t> fingerprint() const;
+
+    /**
+     * @brief Build a context and publish it, keeping the current one on failure.
+     *
+     * @param forced Whether to rebuild even if the watched paths look unchanged.
+     */
+    void rebuild(bool forced);
+
+    std::atomic<std::shared_ptr<ssl::context>> current_;    ///< The published context
+    builder build_;                                         ///< Builds a new context
+    std::vector<std::string> watched_;                      ///< Paths that trigger a reload
+    std::unique_ptr<net::thread_pool> pool_;                ///< The reload thread
+    std::unique_ptr<net::steady_timer> timer_;              ///< Delays a pending reload
+    std::atomic<bool> pending_{false};                      ///< Whether a reload is scheduled
+    std::atomic<bool> forced_{false};                       ///< Whether the scheduled reload was requested by reload()
+    std::vector<std::uint64_t> built_from_;                 ///< Fingerprint of the paths the current context was built from
+};
+
+#endif // TLS_CONTEXT_HPP
@@ -0,0 +1,104 @@
+#ifndef TLS_RECORDS_HPP
+#define TLS_RECORDS_HPP
+
+#include <openssl/ssl.h>
+#include <chrono>
+#include <cstddef>
+
+/**
+ * @brief Dynamic TLS record sizing.
+ *
+ * A TLS record can only be decrypted once it has fully arrived, so a 16 KB record
+ * spread over a dozen segments of a cold congestion window delays the first bytes
+ * of a response by whole round trips. Connections therefore start with records that
+ * fit in one TCP segment, and switch to full-size records, which cost less CPU and
+ * framing per byte, once they have sent enough to have opened the window. A
+ * connection that has not sent anything for a while may have lost its window, and
+ * goes back to small records when the next request arrives.
+ *
+ * Sent records are counted through OpenSSL's message callback, which sees each
+ * record header. The size is chosen by the sessions before each response or
+ * WebSocket message, so a response started in small records ends in them.
+ */
+class tls_records
+{
+public:
+    /**
+     * @brief Access the shared instance.
+     *
+     * @return A reference to the process-wide instance.
+     */
+    static tls_records& instance();
+
+    /**
+     * @brief Enable dynamic record sizing.
+     *
+     * Must be called before the I/O threads start accepting connections.
+     *
+     * @param small_size The payload of a small record, 0 to derive it from each connection's MSS.
+     * @param boost_after Bytes a connection sends in small records before switching, 0 to disable.
+     * @param idle Time without sending after which a connection goes back to small records.
+     */
+    void configure(std::size_t small_size, std::size_t boost_after, std::chrono::milliseconds idle);
+
+    /**
+     * @brief Check whether records are sized dynamically.
+     *
+     * @return True if configure() was called with a non-zero boost threshold.
+     */
+    bool enabled() const
+    {
+        return boost_after_ != 0;
+    }
+
+    /**
+     * @brief Record sizing state of one connection.
+     */
+    class sizer
+    {
+    public:
+        /**
+         * @brief Start sizing the records of a connection whose handshake is complete.
+         *
+         * Only one sizer may be attached to a connection; attaching another, as a
+         * WebSocket session does when it takes over the stream, replaces it.
+         *
+         * @param ssl The connection.
+         * @param fd The connection's socket, to read its MSS from.
+         */
+        void attach(SSL* ssl, int fd);
+
+        /**
+         * @brief Pick the record size for the next response or message.
+         *
+         * Must be called when no write is in progress on the connection.
+         *
+         * @param ssl The connection.
+         */
+        void before_write(SSL* ssl);
+
+    private:
+        /**
+         * @brief OpenSSL callback seeing the header of every record.
+         */
+        static void on_record(int write_p, int version, int content_type,
+                              void const* buf, std::size_t len, SSL* ssl, void* arg);
+
+        std::size_t small_ = 0;                             ///< Payload of a small record on this connection
+        std::size_t sent_ = 0;                              ///< Bytes sent since the last switch to small records
+        bool full_ = false;                                 ///< Whether full-size records are in use
+        std::chrono::steady_clock::time_point last_sent_;   ///< When the last record was sent
+    };
+
+    tls_records(tls_records const&) = delete;
+    tls_records& operator=(tls_records const&) = delete;
+
+private:
+    tls_records() = default;
+
+    std::size_t small_size_ = 0;        ///< Configured small record payload, 0 for the MSS
+    std::size_t boost_after_ = 0;       ///< Bytes sent before switching to full-size records
+    std::chrono::milliseconds idle_{0}; ///< Idle time before going back to small records
+};
+
+#endif // TLS_RECORDS_HPP
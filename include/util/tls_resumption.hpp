@@ -0,0 +1,171 @@
+#ifndef TLS_RESUMPTION_HPP
+#define TLS_RESUMPTION_HPP
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/ssl.h>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief TLS session resumption: a sharded server-side session cache and rotating ticket keys.
+ *
+ * Sessions of clients that resume by session ID are serialized into one of a fixed
+ * number of shards, picked by a hash of the ID, each with its own lock and LRU
+ * bound, so concurrent handshakes rarely contend. Clients that support tickets are
+ * resumed statelessly instead: ticket keys are generated in memory, never written
+ * anywhere, and replaced on a schedule. Tickets sealed with the previous keys are
+ * still accepted, and renewed, until those keys age out. Hits and misses of both
+ * mechanisms are counted in metrics.
+ */
+class tls_resumption
+{
+public:
+    /**
+     * @brief Access the shared instance.
+     *
+     * @return A reference to the process-wide instance.
+     */
+    static tls_resumption& instance();
+
+    /**
+     * @brief Size the session cache and start the ticket key rotation.
+     *
+     * Must be called once, before the first context is passed to apply().
+     *
+     * @param cache_size The maximum number of cached sessions, 0 to disable the server-side cache.
+     * @param ticket_rotation How often a new ticket key is generated, 0 to disable tickets.
+     */
+    void configure(std::size_t cache_size, std::chrono::seconds ticket_rotation);
+
+    /**
+     * @brief Install the session cache and ticket key callbacks on a context.
+     *
+     * The cache and keys live in this instance rather than in the context, so
+     * sessions and tickets stay valid when a reloaded context replaces it.
+     *
+     * @param ctx The server context.
+     */
+    void apply(SSL_CTX* ctx);
+
+    /**
+     * @brief Let sessions established on a default context resume on another one.
+     *
+     * Connections switched to another context by SNI keep using the default context's
+     * session cache and ticket keys; the contexts only need the same session ID context.
+     *
+     * @param ctx A context that connections may be switched to.
+     */
+    static void share(SSL_CTX* ctx);
+
+    /**
+     * @brief Keep a connection's session resumable however the connection ended.
+     *
+     * OpenSSL evicts the session of a connection freed without a close_notify, and
+     * clients that simply drop idle connections would then never resume. Every TLS
+     * session calls this before its stream is destroyed.
+     *
+     * @param ssl The connection, or null if the stream was moved from.
+     */
+    static void keep_resumable(SSL* ssl);
+
+    tls_resumption(tls_resumption const&) = delete;
+    tls_resumption& operator=(tls_resumption const&) = delete;
+
+private:
+    tls_resumption() = default;
+
+    static constexpr std::size_t shard_count = 16;     ///< Number of independently locked cache shards
+    static constexpr std::size_t key_count = 3;        ///< Current ticket key and the previous ones still accepted
+
+    /**
+     * @brief A cached session in DER form.
+     */
+    struct session
+    {
+        std::string der;                        ///< The serialized session
+        std::list<std::string>::iterator lru;   ///< Position in the shard's recency list
+    };
+
+    /**
+     * @brief One lock's worth of the session cache.
+     */
+    struct alignas(64) shard
+    {
+        std::mutex mutex;                                   ///< Protects the members below
+        std::unordered_map<std::string, session> sessions;  ///< Sessions by ID
+        std::list<std::string> lru;                         ///< IDs, most recently used first
+    };
+
+    /**
+     * @brief Key material of one ticket key.
+     */
+    struct ticket_key
+    {
+        unsigned char name[16];     ///< Identifies the key in the tickets it sealed
+        unsigned char aes[32];      ///< AES-256-CBC encryption key
+        unsigned char hmac[32];     ///< HMAC-SHA256 key
+    };
+
+    /**
+     * @brief Pick the shard of a session ID.
+     */
+    shard& shard_for(std::string const& id);
+
+    /**
+     * @brief Generate a new current key if the rotation is due. Must be called with keys_mutex_ held.
+     */
+    void rotate();
+
+    /**
+     * @brief OpenSSL callback storing a new session. Returns 0, as no reference is kept.
+     */
+    static int new_session(SSL* ssl, SSL_SESSION* sess);
+
+    /**
+     * @brief OpenSSL callback looking up a session by ID.
+     */
+    static SSL_SESSION* get_session(SSL* ssl, unsigned char const* id, int length, int* copy);
+
+    /**
+     * @brief OpenSSL callback dropping a session that is no longer valid.
+     */
+    static void remove_session(SSL_CTX* ctx, SSL_SESSION* sess);
+
+    /**
+     * @brief OpenSSL callback initializing the cipher and MAC for sealing or opening a ticket.
+     */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    static int ticket_key_cb(SSL* ssl, unsigned char* name, unsigned char* iv,
+                             EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int seal);
+#else
+    static int ticket_key_cb(SSL* ssl, unsigned char* name, unsigned char* iv,
+                             EVP_CIPHER_CTX* cipher, HMAC_CTX* mac, int seal);
+#endif
+
+    /**
+     * @brief Select the key for sealing a new ticket, or find the key of a received one.
+     *
+     * @param name The key name, written when sealing and read when opening.
+     * @param key Receives the key material.
+     * @param seal True to seal a new ticket.
+     * @return 1 for the current key, 2 for a previous one (the ticket is renewed), 0 if unknown.
+     */
+    int select_key(unsigned char* name, ticket_key& key, bool seal);
+
+    std::array<shard, shard_count> shards_;                 ///< The session cache
+    std::size_t shard_capacity_ = 0;                        ///< Maximum sessions per shard
+
+    std::mutex keys_mutex_;                                 ///< Protects the members below
+    std::array<ticket_key, key_count> keys_{};              ///< Current key first
+    std::size_t keys_used_ = 0;                             ///< Number of generated keys in keys_
+    std::chrono::seconds rotation_{0};                      ///< Time between key generations
+    std::chrono::steady_clock::time_point next_rotation_;   ///< When the next key is generated
+};
+
+#endif // TLS_RESUMPTION_HPP
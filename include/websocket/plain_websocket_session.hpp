@@ -43,6 +43,15 @@ class plain_websocket_session
     {
         return ws_;
     }
+
+    /**
+     * @brief Prepare the stream for the next message.
+     * 
+     * Nothing to do for plain TCP.
+     */
+    void before_write()
+    {
+    }
 };
 
 #endif
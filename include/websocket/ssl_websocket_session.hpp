@@ -3,6 +3,17 @@
 
 #include "../../include/util/beast.hpp"
 #include "websocket_session.hpp"
+#include "../../include/util/tls_records.hpp"
+#include "../../include/util/tls_resumption.hpp"
+
+/**
+ * @brief An SSL stream released for a WebSocket upgrade, with the context it was created with.
+ */
+struct released_ssl_stream
+{
+    ssl::stream<beast::tcp_stream> stream;  ///< The SSL stream
+    std::shared_ptr<ssl::context> ctx;      ///< Its context, kept alive across certificate reloads
+};
 
 /**
  * @brief Class for handling SSL WebSocket connections.
@@ -10,12 +21,17 @@
  * This class extends the `websocket_session` template to manage a WebSocket session
  * over an SSL/TLS connection. It manages the WebSocket stream, including reading, writing,
  * and other WebSocket-specific operations while ensuring secure communication.
+ * Like ssl_http_session, it keeps the SSL context of its connection alive, so a
+ * certificate reload cannot free it, or the SNI table its callbacks use, while
+ * the connection is open.
  */
 class ssl_websocket_session
     : public websocket_session<ssl_websocket_session>
     , public std::enable_shared_from_this<ssl_websocket_session>
 {
+    std::shared_ptr<ssl::context> ctx_;                     ///< The context the stream was created with, kept across reloads
     websocket::stream<ssl::stream<beast::tcp_stream>> ws_; ///< The WebSocket stream for SSL/TLS connections.
+    tls_records::sizer records_;                            ///< Sizes the records of outgoing frames
 
 public:
     /**
@@ -23,13 +39,24 @@ public:
      * 
      * This constructor moves the provided SSL stream into the WebSocket stream, which
      * will be used to manage WebSocket-specific operations such as reading and writing messages
-     * over a secure SSL/TLS connection.
+     * over a secure SSL/TLS connection. Record sizing restarts with small records,
+     * taking over from the HTTP session the stream was released by.
      * 
-     * @param stream The SSL stream used for the WebSocket connection.
+     * @param released The SSL stream used for the WebSocket connection and its context.
+     */
+    explicit ssl_websocket_session(released_ssl_stream&& released)
+        : ctx_(std::move(released.ctx))
+        , ws_(std::move(released.stream))  // Move the SSL stream into the WebSocket stream
+    {
+        records_.attach(ws_.next_layer().native_handle(), beast::get_lowest_layer(ws_).socket().native_handle());
+    }
+
+    /**
+     * @brief Keep the TLS session resumable however the connection ended.
      */
-    explicit ssl_websocket_session(ssl::stream<beast::tcp_stream>&& stream)
-        : ws_(std::move(stream))  // Move the SSL stream into the WebSocket stream
+    ~ssl_websocket_session()
     {
+        tls_resumption::keep_resumable(ws_.next_layer().native_handle());
     }
 
     /**
@@ -44,6 +71,16 @@ public:
     {
         return ws_;
     }
+
+    /**
+     * @brief Size the TLS records of the next message.
+     * 
+     * Called by the base class before each message is written.
+     */
+    void before_write()
+    {
+        records_.before_write(ws_.next_layer().native_handle());
+    }
 };
 
 #endif
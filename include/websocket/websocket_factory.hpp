@@ -35,12 +35,12 @@ void make_websocket_session(
  * 
  * @tparam Body The type of the HTTP request body.
  * @tparam Allocator The type of the allocator used in the HTTP request.
- * @param stream The SSL stream used for the WebSocket connection.
+ * @param stream The SSL stream used for the WebSocket connection and its context.
  * @param req The HTTP request to be handled by the WebSocket session.
  */
 template<class Body, class Allocator>
 void make_websocket_session(
-    ssl::stream<beast::tcp_stream> stream,
+    released_ssl_stream stream,
     http::request<Body, http::basic_fields<Allocator>> req)
 {
     // Create an SSL WebSocket session and run it with the given request
@@ -3,6 +3,7 @@
 
 #include "../util/util.hpp"
 #include "../util/beast.hpp"
+#include "../util/metrics.hpp"
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
 #include <boost/asio/strand.hpp>
@@ -67,8 +68,6 @@ class websocket_session
      */
     void on_read(beast::error_code ec, std::size_t bytes_transferred)
     {
-        boost::ignore_unused(bytes_transferred);
-
         // Handle connection closure
         if(ec == websocket::error::closed)
             return;
@@ -76,7 +75,10 @@ class websocket_session
         if(ec)
             return fail(ec, "read");
 
+        metrics::add(metrics::bytes_in, bytes_transferred);
+
         // Echo the message back to the client
+        derived().before_write();
         derived().ws().text(derived().ws().got_text());
         derived().ws().async_write(
                 buffer_.data(),
@@ -97,11 +99,11 @@ class websocket_session
      */
     void on_write(beast::error_code ec, std::size_t bytes_transferred)
     {
-        boost::ignore_unused(bytes_transferred);
-
         if(ec)
             return fail(ec, "write");
 
+        metrics::add(metrics::bytes_out, bytes_transferred);
+
         // Clear the buffer after writing
         buffer_.consume(buffer_.size());
 
@@ -110,6 +112,22 @@ class websocket_session
     }
 
     public:
+    /**
+     * @brief Constructor, counting the session as active.
+     */
+    websocket_session()
+    {
+        metrics::add(metrics::websocket_sessions);
+    }
+
+    /**
+     * @brief Destructor, removing the session from the active count.
+     */
+    ~websocket_session()
+    {
+        metrics::add(metrics::websocket_sessions, -1);
+    }
+
     /**
      * @brief Start the WebSocket session by accepting an HTTP upgrade request.
      * 
@@ -0,0 +1,198 @@
+#include "../../include/http/access_log.hpp"
+#include "../../include/util/timestamp.hpp"
+#include <boost/beast/http/verb.hpp>
+
+namespace {
+
+// Append a string as a JSON string literal
+void append_json(std::string& out, std::string_view s)
+{
+    static char const hex[] = "0123456789abcdef";
+
+    out.push_back('"');
+    for(char c : s)
+    {
+        auto const u = static_cast<unsigned char>(c);
+        if(c == '"' || c == '\\')
+        {
+            out.push_back('\\');
+            out.push_back(c);
+        }
+        else if(u < 0x20)
+        {
+            out.append("\\u00");
+            out.push_back(hex[u >> 4]);
+            out.push_back(hex[u & 0xf]);
+        }
+        else
+        {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+} // namespace
+
+/**
+ * @brief Access the shared access log instance.
+ * 
+ * @return A reference to the process-wide access log.
+ */
+access_log& access_log::instance()
+{
+    static access_log log;
+    return log;
+}
+
+/**
+ * @brief Enable the access log and start the flusher thread.
+ * 
+ * @param logger The logger that receives the formatted batches.
+ * @param interval How often the rings are drained.
+ */
+void access_log::configure(std::shared_ptr<Logger> logger, std::chrono::milliseconds interval)
+{
+    logger_ = std::move(logger);
+    interval_ = interval;
+    thread_ = std::thread([this] { run(); });
+}
+
+/**
+ * @brief Stop the flusher thread after writing out the remaining entries.
+ */
+access_log::~access_log()
+{
+    if(! thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+}
+
+/**
+ * @brief Record a completed request from the calling I/O thread.
+ * 
+ * Copies the entry into the thread's ring. The flusher is woken early when the
+ * ring becomes half full, so bursts do not have to wait for the next interval.
+ * 
+ * @param entry The entry to record.
+ */
+void access_log::record(access_entry const& entry)
+{
+    ring& r = local_ring();
+
+    std::size_t const head = r.head.load(std::memory_order_relaxed);
+    std::size_t const used = head - r.tail.load(std::memory_order_acquire);
+    if(used == ring::capacity)
+    {
+        r.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    r.entries[head & (ring::capacity - 1)] = entry;
+    r.head.store(head + 1, std::memory_order_release);
+
+    if(used + 1 == ring::capacity / 2)
+    {
+        flush_requested_.store(true, std::memory_order_relaxed);
+        wakeup_.notify_one();
+    }
+}
+
+/**
+ * @brief Get the calling thread's ring, registering it on first use.
+ * 
+ * Rings are never unregistered so that the flusher can still drain entries left
+ * by a thread that has exited.
+ */
+access_log::ring& access_log::local_ring()
+{
+    thread_local ring* local = nullptr;
+    if(! local)
+    {
+        auto r = std::make_unique<ring>();
+        local = r.get();
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(std::move(r));
+    }
+    return *local;
+}
+
+/**
+ * @brief Drain every ring and write the formatted batch.
+ * 
+ * Each entry becomes one JSON line; the whole batch is handed to the logger at once.
+ */
+void access_log::flush()
+{
+    std::vector<ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto& r : rings_)
+            rings.push_back(r.get());
+    }
+
+    batch_.clear();
+    std::uint64_t dropped = 0;
+
+    for(ring* r : rings)
+    {
+        std::size_t tail = r->tail.load(std::memory_order_relaxed);
+        std::size_t const head = r->head.load(std::memory_order_acquire);
+
+        for(; tail != head; ++tail)
+        {
+            access_entry const& e = r->entries[tail & (ring::capacity - 1)];
+            auto const method = boost::beast::http::to_string(e.method);
+
+            batch_.append("{\"time\":\"").append(timestamp::local_micros(e.time));
+            batch_.append("\",\"method\":");
+            append_json(batch_, std::string_view(method.data(), method.size()));
+            batch_.append(",\"target\":");
+            append_json(batch_, std::string_view(e.target, e.target_size));
+            batch_.append(",\"status\":").append(std::to_string(e.status));
+            batch_.append(",\"bytes\":").append(std::to_string(e.bytes));
+            batch_.append(",\"parse_us\":").append(std::to_string(e.parse_us));
+            batch_.append(",\"handle_us\":").append(std::to_string(e.handle_us));
+            batch_.append(",\"write_us\":").append(std::to_string(e.write_us));
+            batch_.append("}\n");
+        }
+
+        r->tail.store(tail, std::memory_order_release);
+        dropped += r->dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    if(dropped)
+        batch_.append("{\"dropped\":").append(std::to_string(dropped)).append("}\n");
+
+    if(! batch_.empty())
+        logger_->writeRaw(batch_);
+}
+
+/**
+ * @brief Flusher thread loop: drain on every interval or early wakeup until stopped.
+ */
+void access_log::run()
+{
+    for(;;)
+    {
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait_for(lock, interval_,
+                [this] { return stop_ || flush_requested_.load(std::memory_order_relaxed); });
+            flush_requested_.store(false, std::memory_order_relaxed);
+            stop = stop_;
+        }
+
+        flush();
+
+        if(stop)
+            return;
+    }
+}
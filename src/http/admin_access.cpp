@@ -0,0 +1,123 @@
+#include "../../include/http/admin_access.hpp"
+#include "../../include/log/log.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * @brief Reduce an IPv4-mapped IPv6 address to its IPv4 form.
+ */
+boost::asio::ip::address unmap(boost::asio::ip::address const& address)
+{
+    if(address.is_v6() && address.to_v6().is_v4_mapped())
+        return boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped, address.to_v6());
+    return address;
+}
+
+} // namespace
+
+/**
+ * @brief Access the shared instance.
+ *
+ * @return A reference to the process-wide instance.
+ */
+admin_access& admin_access::instance()
+{
+    static admin_access access;
+    return access;
+}
+
+/**
+ * @brief Set the allowed networks.
+ *
+ * @param list Comma-separated addresses and CIDR networks, e.g. "127.0.0.1,10.0.0.0/8,::1".
+ */
+void admin_access::configure(std::string const& list)
+{
+    networks_.clear();
+
+    std::size_t start = 0;
+    while(start <= list.size())
+    {
+        auto end = list.find(',', start);
+        if(end == std::string::npos)
+            end = list.size();
+        auto entry = list.substr(start, end - start);
+        start = end + 1;
+
+        entry.erase(0, entry.find_first_not_of(' '));
+        entry.erase(entry.find_last_not_of(' ') + 1);
+        if(entry.empty())
+            continue;
+
+        auto const slash = entry.find('/');
+        boost::system::error_code ec;
+        auto const address = unmap(boost::asio::ip::make_address(entry.substr(0, slash), ec));
+        if(ec)
+            throw std::invalid_argument("Invalid admin address: " + entry);
+
+        network net;
+        net.v6 = address.is_v6();
+        unsigned const bits = net.v6 ? 128 : 32;
+        if(net.v6)
+            net.bytes = address.to_v6().to_bytes();
+        else
+        {
+            auto const v4 = address.to_v4().to_bytes();
+            std::copy(v4.begin(), v4.end(), net.bytes.begin());
+        }
+
+        net.prefix = bits;
+        if(slash != std::string::npos)
+        {
+            auto const prefix = entry.substr(slash + 1);
+            if(prefix.empty() || prefix.find_first_not_of("0123456789") != std::string::npos
+                || std::stoul(prefix) > bits)
+                throw std::invalid_argument("Invalid admin network: " + entry);
+            net.prefix = static_cast<unsigned>(std::stoul(prefix));
+        }
+        networks_.push_back(net);
+    }
+
+    auto logger = LoggerManager::getLogger("admin_access_logger", LogLevel::INFO);
+    LOG_INFO(logger, "Admin endpoints allowed from ", networks_.size(), " networks: ", list);
+}
+
+/**
+ * @brief Check whether a client may use the admin endpoints.
+ *
+ * @param client The client's address.
+ * @return True if it belongs to one of the allowed networks.
+ */
+bool admin_access::allowed(boost::asio::ip::address const& client) const
+{
+    auto const address = unmap(client);
+    std::array<unsigned char, 16> bytes{};
+    if(address.is_v6())
+        bytes = address.to_v6().to_bytes();
+    else
+    {
+        auto const v4 = address.to_v4().to_bytes();
+        std::copy(v4.begin(), v4.end(), bytes.begin());
+    }
+
+    for(auto const& net : networks_)
+    {
+        if(net.v6 != address.is_v6())
+            continue;
+
+        unsigned const whole = net.prefix / 8;
+        unsigned const rest = net.prefix % 8;
+        if(! std::equal(bytes.begin(), bytes.begin() + whole, net.bytes.begin()))
+            continue;
+        if(rest != 0)
+        {
+            unsigned char const mask = static_cast<unsigned char>(0xff << (8 - rest));
+            if((bytes[whole] & mask) != (net.bytes[whole] & mask))
+                continue;
+        }
+        return true;
+    }
+    return false;
+}
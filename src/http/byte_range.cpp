@@ -0,0 +1,120 @@
+#include "../../include/http/byte_range.hpp"
+#include <algorithm>
+#include <charconv>
+
+namespace {
+
+/**
+ * @brief Strip optional whitespace around a list element.
+ */
+std::string_view trim(std::string_view s)
+{
+    while(! s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while(! s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        s.remove_suffix(1);
+    return s;
+}
+
+/**
+ * @brief Parse a non-empty run of decimal digits.
+ */
+bool parse_number(std::string_view s, std::uint64_t& value)
+{
+    if(s.empty())
+        return false;
+    auto const [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    return ec == std::errc{} && end == s.data() + s.size();
+}
+
+} // namespace
+
+/**
+ * @brief Parse a Range header value against a representation size.
+ *
+ * @param header The Range header value.
+ * @param size The size of the representation.
+ * @param ranges Receives the satisfiable ranges, sorted and disjoint.
+ * @param max_ranges The largest number of specs honoured.
+ * @return How to answer the request.
+ */
+range_result parse_range(std::string_view header, std::uint64_t size, std::vector<byte_range>& ranges,
+                         std::size_t max_ranges)
+{
+    ranges.clear();
+
+    constexpr std::string_view unit = "bytes=";
+    header = trim(header);
+    if(header.substr(0, unit.size()) != unit)
+        return range_result::ignore;
+    header.remove_prefix(unit.size());
+
+    std::size_t specs = 0;
+    while(! header.empty())
+    {
+        auto const comma = header.find(',');
+        auto const spec = trim(header.substr(0, comma));
+        header.remove_prefix(comma == std::string_view::npos ? header.size() : comma + 1);
+
+        // Empty list elements are allowed.
+        if(spec.empty())
+            continue;
+        if(++specs > max_ranges)
+            return range_result::ignore;
+
+        auto const dash = spec.find('-');
+        if(dash == std::string_view::npos)
+            return range_result::ignore;
+
+        auto const first_text = spec.substr(0, dash);
+        auto const last_text = spec.substr(dash + 1);
+        std::uint64_t first = 0, last = 0;
+
+        if(first_text.empty())
+        {
+            // Suffix range: the final N bytes.
+            if(! parse_number(last_text, last))
+                return range_result::ignore;
+            if(last == 0 || size == 0)
+                continue;
+            auto const n = last < size ? last : size;
+            ranges.push_back({size - n, n});
+            continue;
+        }
+
+        if(! parse_number(first_text, first))
+            return range_result::ignore;
+
+        if(last_text.empty())
+            last = UINT64_MAX;
+        else if(! parse_number(last_text, last) || last < first)
+            return range_result::ignore;
+
+        if(first >= size)
+            continue;
+        if(last >= size)
+            last = size - 1;
+        ranges.push_back({first, last - first + 1});
+    }
+
+    if(specs == 0)
+        return range_result::ignore;
+    if(ranges.empty())
+        return range_result::unsatisfiable;
+
+    // Coalesce overlapping and adjacent ranges, so that no byte is sent twice.
+    std::sort(ranges.begin(), ranges.end(),
+        [](byte_range const& a, byte_range const& b) { return a.offset < b.offset; });
+    std::size_t merged = 0;
+    for(std::size_t i = 1; i < ranges.size(); ++i)
+    {
+        auto& last = ranges[merged];
+        auto const& next = ranges[i];
+        if(next.offset <= last.offset + last.size)
+            last.size = std::max(last.size, next.offset + next.size - last.offset);
+        else
+            ranges[++merged] = next;
+    }
+    ranges.resize(merged + 1);
+    return range_result::satisfiable;
+}
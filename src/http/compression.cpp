@@ -0,0 +1,199 @@
+#include "../../include/http/compression.hpp"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * @brief Access the shared compression instance.
+ *
+ * @return A reference to the process-wide instance.
+ */
+compression& compression::instance()
+{
+    static compression instance;
+    return instance;
+}
+
+/**
+ * @brief Enable compression.
+ *
+ * @param min_size Files smaller than this are sent uncompressed.
+ * @param cache_capacity The maximum number of compressed bytes kept in the cache.
+ * @param max_cached_file_size Larger files are compressed while streaming instead of cached.
+ */
+void compression::configure(std::uint64_t min_size, std::uint64_t cache_capacity, std::uint64_t max_cached_file_size)
+{
+    min_size_ = min_size;
+    capacity_ = cache_capacity;
+    max_cached_file_size_ = cache_capacity ? max_cached_file_size : 0;
+    enabled_ = true;
+
+    if(max_cached_file_size_ != 0 && ! pool_)
+        pool_ = std::make_unique<net::thread_pool>(1);
+}
+
+/**
+ * @brief Let the file being compressed finish before the worker thread is destroyed.
+ */
+compression::~compression()
+{
+    if(pool_)
+        pool_->join();
+}
+
+/**
+ * @brief Check whether a response would be compressed for some client.
+ *
+ * Only textual types are compressed; images, media, archives and unknown types
+ * are usually compressed already.
+ *
+ * @param content_type The Content-Type of the response.
+ * @return True if responses of this type vary by Accept-Encoding.
+ */
+bool compression::compressible(std::string_view content_type) const
+{
+    if(! enabled_)
+        return false;
+
+    return content_type.substr(0, 5) == "text/"
+        || content_type == "application/javascript"
+        || content_type == "application/json"
+        || content_type == "application/xml"
+        || content_type == "image/svg+xml";
+}
+
+/**
+ * @brief Pick the coding for a response.
+ *
+ * @param accepted The codings the client accepts, from precompressed::accepted().
+ * @param content_type The Content-Type of the response, from mime_type().
+ * @return precompressed::gzip or precompressed::deflate, or 0 to send the response as is.
+ */
+unsigned compression::negotiate(unsigned accepted, std::string_view content_type) const
+{
+    if(! compressible(content_type))
+        return 0;
+    if(accepted & precompressed::gzip)
+        return precompressed::gzip;
+    if(accepted & precompressed::deflate)
+        return precompressed::deflate;
+    return 0;
+}
+
+/**
+ * @brief Build the cache key of a file version and coding.
+ */
+std::string compression::key(std::string const& path, std::int64_t mtime_ns, unsigned coding)
+{
+    std::string k = path;
+    k += '\0';
+    k += std::to_string(mtime_ns);
+    k += '\0';
+    k += token(coding);
+    return k;
+}
+
+/**
+ * @brief Get the compressed contents of a file, compressing it in the background on a miss.
+ *
+ * @param path The path of the file.
+ * @param mtime_ns The file's modification time, in nanoseconds.
+ * @param coding The coding, gzip or deflate.
+ * @return The compressed data, or null until it is ready.
+ */
+compression::buffer_type compression::get(std::string const& path, std::int64_t mtime_ns, unsigned coding)
+{
+    auto k = key(path, mtime_ns, coding);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(k);
+    if(it != entries_.end())
+    {
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        return it->second.data;
+    }
+
+    if(pool_ && pending_.insert(k).second)
+        net::post(*pool_, [this, k = std::move(k), path, mtime_ns, coding]
+        {
+            compress(k, path, mtime_ns, coding);
+        });
+    return nullptr;
+}
+
+/**
+ * @brief Read and compress a file on the worker thread, then cache the output.
+ *
+ * The output is only cached if the file still has the modification time it was
+ * queued with, so a file replaced in the meantime is not cached under the old key.
+ * Compressing once per file version pays off at any level, but the default one
+ * keeps the queue short when many files change at once.
+ */
+void compression::compress(std::string const& key, std::string const& path, std::int64_t mtime_ns, unsigned coding)
+{
+    auto const output = [&]() -> buffer_type
+    {
+        beast::error_code ec;
+        beast::file file;
+        file.open(path.c_str(), beast::file_mode::scan, ec);
+        struct stat st;
+        if(ec || ::fstat(file.native_handle(), &st) != 0 || ! S_ISREG(st.st_mode)
+            || static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec != mtime_ns)
+            return nullptr;
+
+        std::string input(static_cast<std::size_t>(st.st_size), '\0');
+        std::size_t done = 0;
+        while(done < input.size())
+        {
+            auto const n = ::pread(file.native_handle(), input.data() + done, input.size() - done, static_cast<off_t>(done));
+            if(n <= 0)
+                return nullptr;
+            done += static_cast<std::size_t>(n);
+        }
+
+        z_stream zs{};
+        if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits(coding), 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            return nullptr;
+
+        auto data = std::make_shared<std::string>(deflateBound(&zs, static_cast<uLong>(input.size())), '\0');
+        zs.next_in = reinterpret_cast<Bytef*>(input.data());
+        zs.avail_in = static_cast<uInt>(input.size());
+        zs.next_out = reinterpret_cast<Bytef*>(data->data());
+        zs.avail_out = static_cast<uInt>(data->size());
+        int const ret = deflate(&zs, Z_FINISH);
+        data->resize(zs.total_out);
+        deflateEnd(&zs);
+        if(ret != Z_STREAM_END)
+            return nullptr;
+        return data;
+    }();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.erase(key);
+    if(output && entries_.find(key) == entries_.end() && output->size() <= capacity_)
+        insert(key, output);
+}
+
+/**
+ * @brief Insert an entry and evict the least recently used ones over capacity.
+ *
+ * Must be called with mutex_ held.
+ */
+void compression::insert(std::string const& key, buffer_type data)
+{
+    lru_.push_front(key);
+    size_ += data->size();
+    entries_.emplace(key, entry{std::move(data), lru_.begin()});
+
+    while(size_ > capacity_ && ! lru_.empty())
+        erase(entries_.find(lru_.back()));
+}
+
+/**
+ * @brief Remove an entry. Must be called with mutex_ held.
+ */
+void compression::erase(std::unordered_map<std::string, entry>::iterator it)
+{
+    size_ -= it->second.data->size();
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
@@ -0,0 +1,159 @@
+#include "../../include/http/fd_cache.hpp"
+#include "../../include/util/file_watcher.hpp"
+#include "../../include/log/log.hpp"
+#include <sys/stat.h>
+
+/**
+ * @brief Access the shared cache instance.
+ *
+ * @return A reference to the process-wide cache.
+ */
+fd_cache& fd_cache::instance()
+{
+    static fd_cache cache;
+    return cache;
+}
+
+/**
+ * @brief Enable the cache and subscribe it to file change notifications if possible.
+ *
+ * @param capacity The maximum number of open files held, 0 to disable the cache.
+ * @param ttl How long an entry is trusted when inotify is not available.
+ * @param map_min_size The smallest file served from a mapping.
+ * @param map_max_size The largest file served from a mapping, 0 to never map files.
+ */
+void fd_cache::configure(std::size_t capacity, std::chrono::milliseconds ttl,
+                         std::uint64_t map_min_size, std::uint64_t map_max_size)
+{
+    if(capacity == 0)
+        return;
+
+    auto logger = LoggerManager::getLogger("fd_cache_logger", LogLevel::INFO);
+
+    auto& watcher = file_watcher::instance();
+    if(watcher.available())
+    {
+        watcher.subscribe(
+            [this](std::string const& path)
+            {
+                invalidate(path);
+            });
+        watched_ = true;
+    }
+    else
+    {
+        LOG_WARN(logger, "File descriptor cache entries expire after ", ttl.count(), " ms: inotify is not available.");
+    }
+
+    capacity_ = capacity;
+    ttl_ = ttl;
+    map_min_size_ = map_min_size;
+    map_max_size_ = map_max_size;
+
+    LOG_INFO(logger, "File descriptor cache enabled with ", capacity, " files.");
+}
+
+/**
+ * @brief Get an open file, opening it on a miss.
+ *
+ * As in file_cache, the watch is installed before the file is opened and the entry
+ * is only inserted if no invalidation happened in the meantime.
+ *
+ * @param path The path of the file.
+ * @return The open file, or null if the caller must open it itself.
+ */
+fd_cache::entry_type fd_cache::get(std::string const& path)
+{
+    if(! enabled())
+        return nullptr;
+
+    auto const now = std::chrono::steady_clock::now();
+    std::uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(path);
+        if(it != entries_.end())
+        {
+            if(watched_ || now < it->second.expires)
+            {
+                lru_.splice(lru_.begin(), lru_, it->second.lru);
+                return it->second.value;
+            }
+            erase(it);
+        }
+        generation = generation_;
+    }
+
+    if(watched_ && ! file_watcher::instance().watch(path))
+        return nullptr;
+
+    auto value = open(path);
+    if(! value)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(generation == generation_ && entries_.find(path) == entries_.end())
+    {
+        lru_.push_front(path);
+        entries_.emplace(path, slot{value, now + ttl_, lru_.begin()});
+        if(entries_.size() > capacity_)
+            erase(entries_.find(lru_.back()));
+    }
+    return value;
+}
+
+/**
+ * @brief Drop a cached file.
+ *
+ * @param path The path of the file, or an empty string to drop every entry.
+ */
+void fd_cache::invalidate(std::string const& path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+
+    if(path.empty())
+    {
+        entries_.clear();
+        lru_.clear();
+        return;
+    }
+
+    auto it = entries_.find(path);
+    if(it != entries_.end())
+        erase(it);
+}
+
+/**
+ * @brief Open a file and stat it.
+ *
+ * @param path The path of the file.
+ * @return The open file, or null if it cannot be opened or is not a regular file.
+ */
+fd_cache::entry_type fd_cache::open(std::string const& path)
+{
+    auto file = std::make_shared<beast::file>();
+    beast::error_code ec;
+    file->open(path.c_str(), beast::file_mode::scan, ec);
+    if(ec)
+        return nullptr;
+
+    struct stat st;
+    if(::fstat(file->native_handle(), &st) != 0 || ! S_ISREG(st.st_mode))
+        return nullptr;
+
+    auto result = std::make_shared<entry>();
+    result->file = std::move(file);
+    result->size = static_cast<std::uint64_t>(st.st_size);
+    result->mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return result;
+}
+
+/**
+ * @brief Remove an entry. Must be called with mutex_ held.
+ */
+void fd_cache::erase(std::unordered_map<std::string, slot>::iterator it)
+{
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
@@ -0,0 +1,213 @@
+#include "../../include/http/file_cache.hpp"
+#include "../../include/http/file_io.hpp"
+#include "../../include/util/file_watcher.hpp"
+#include "../../include/log/log.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Access the shared cache instance.
+ * 
+ * @return A reference to the process-wide cache.
+ */
+file_cache& file_cache::instance()
+{
+    static file_cache cache;
+    return cache;
+}
+
+/**
+ * @brief Enable the cache and subscribe it to file change notifications.
+ * 
+ * The cache stays disabled if inotify is unavailable, since entries could
+ * never be invalidated.
+ * 
+ * @param capacity The maximum number of content bytes held by the cache, 0 to disable it.
+ * @param max_file_size The largest file that will be cached.
+ */
+void file_cache::configure(std::uint64_t capacity, std::uint64_t max_file_size)
+{
+    if(capacity == 0)
+        return;
+
+    auto logger = LoggerManager::getLogger("file_cache_logger", LogLevel::INFO);
+
+    auto& watcher = file_watcher::instance();
+    if(! watcher.available())
+    {
+        LOG_WARN(logger, "File cache disabled: inotify is not available.");
+        return;
+    }
+
+    watcher.subscribe(
+        [this](std::string const& path)
+        {
+            invalidate(path);
+        });
+
+    capacity_ = capacity;
+    max_file_size_ = max_file_size;
+
+    LOG_INFO(logger, "File cache enabled with ", capacity, " bytes.");
+}
+
+/**
+ * @brief Get the contents of a file, loading it into the cache on a miss.
+ * 
+ * The watch is installed before the file is read, and the loaded buffer is only
+ * inserted if no invalidation happened in the meantime, so a concurrent change
+ * can never leave stale contents in the cache.
+ * 
+ * @param path The path of the file.
+ * @return The file contents, or null if the file must be served from disk.
+ */
+file_cache::buffer_type file_cache::get(std::string const& path)
+{
+    if(! enabled())
+        return nullptr;
+
+    std::uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(path);
+        if(it != entries_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            return it->second.data;
+        }
+        generation = generation_;
+    }
+
+    if(! file_watcher::instance().watch(path))
+        return nullptr;
+
+    if(! file_io::instance().enabled())
+        return fill(path, generation);
+
+    // Load once in the background, however many requests miss meanwhile.
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(! loading_.insert(path).second)
+            return nullptr;
+    }
+    file_io::instance().post([this, path, generation]
+    {
+        fill(path, generation);
+        std::lock_guard<std::mutex> lock(mutex_);
+        loading_.erase(path);
+    });
+    return nullptr;
+}
+
+/**
+ * @brief Load a file and insert it unless it changed in the meantime.
+ * 
+ * @param path The path of the file.
+ * @param generation The generation observed before the file was watched.
+ * @return The file contents, or null if the file cannot be cached.
+ */
+file_cache::buffer_type file_cache::fill(std::string const& path, std::uint64_t generation)
+{
+    bool too_large = false;
+    buffer_type data = load(path, too_large);
+    if(! data && ! too_large)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(generation == generation_ && entries_.find(path) == entries_.end())
+        insert(path, data);
+    return data;
+}
+
+/**
+ * @brief Drop a cached file.
+ * 
+ * @param path The path of the file, or an empty string to drop every entry.
+ */
+void file_cache::invalidate(std::string const& path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+
+    if(path.empty())
+    {
+        entries_.clear();
+        lru_.clear();
+        size_ = 0;
+        return;
+    }
+
+    auto it = entries_.find(path);
+    if(it != entries_.end())
+        erase(it);
+}
+
+/**
+ * @brief Read a file into a new buffer.
+ * 
+ * @param path The path of the file.
+ * @param too_large Set to true if the file exceeds the per-file limit.
+ * @return The file contents, or null if the file could not be read or is too large.
+ */
+file_cache::buffer_type file_cache::load(std::string const& path, bool& too_large) const
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if(::fstat(fd, &st) != 0 || ! S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    if(static_cast<std::uint64_t>(st.st_size) > max_file_size_)
+    {
+        ::close(fd);
+        too_large = true;
+        return nullptr;
+    }
+
+    auto data = std::make_shared<std::string>(static_cast<std::size_t>(st.st_size), '\0');
+    std::size_t done = 0;
+    while(done < data->size())
+    {
+        ssize_t n = ::read(fd, data->data() + done, data->size() - done);
+        if(n <= 0)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+        done += static_cast<std::size_t>(n);
+    }
+
+    ::close(fd);
+    return data;
+}
+
+/**
+ * @brief Insert an entry and evict the least recently used ones over capacity.
+ * 
+ * Must be called with mutex_ held.
+ */
+void file_cache::insert(std::string const& path, buffer_type data)
+{
+    lru_.push_front(path);
+    size_ += data ? data->size() : 0;
+    entries_.emplace(path, entry{std::move(data), lru_.begin()});
+
+    while(size_ > capacity_ && ! lru_.empty())
+        erase(entries_.find(lru_.back()));
+}
+
+/**
+ * @brief Remove an entry. Must be called with mutex_ held.
+ */
+void file_cache::erase(std::unordered_map<std::string, entry>::iterator it)
+{
+    size_ -= it->second.data ? it->second.data->size() : 0;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
@@ -0,0 +1,38 @@
+#include "../../include/http/file_io.hpp"
+#include "../../include/log/log.hpp"
+
+/**
+ * @brief Access the shared backend instance.
+ *
+ * @return A reference to the process-wide backend.
+ */
+file_io& file_io::instance()
+{
+    static file_io backend;
+    return backend;
+}
+
+/**
+ * @brief Start the reader threads.
+ *
+ * @param threads The number of reader threads, 0 to keep reads on the I/O threads.
+ */
+void file_io::configure(std::size_t threads)
+{
+    if(threads == 0 || pool_)
+        return;
+
+    pool_ = std::make_unique<net::thread_pool>(threads);
+
+    auto logger = LoggerManager::getLogger("file_io_logger", LogLevel::INFO);
+    LOG_INFO(logger, "Asynchronous file reads enabled with ", threads, " threads.");
+}
+
+/**
+ * @brief Wait for the reads in progress before the threads are destroyed.
+ */
+file_io::~file_io()
+{
+    if(pool_)
+        pool_->join();
+}
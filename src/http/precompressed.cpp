@@ -0,0 +1,287 @@
+#include "../../include/http/precompressed.hpp"
+#include "../../include/util/file_watcher.hpp"
+#include "../../include/log/log.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <utility>
+#include <sys/stat.h>
+
+/**
+ * @brief Access the shared index instance.
+ *
+ * @return A reference to the process-wide index.
+ */
+precompressed& precompressed::instance()
+{
+    static precompressed index;
+    return index;
+}
+
+/**
+ * @brief Subscribe to file change notifications, or stay disabled without inotify.
+ */
+precompressed::precompressed()
+{
+    auto& watcher = file_watcher::instance();
+    if(! watcher.available())
+    {
+        auto logger = LoggerManager::getLogger("precompressed_logger", LogLevel::INFO);
+        LOG_WARN(logger, "Precompressed variants disabled: inotify is not available.");
+        return;
+    }
+
+    watcher.subscribe([this](std::string const& path) { invalidate(path); });
+    enabled_ = true;
+}
+
+/**
+ * @brief Bound the index.
+ *
+ * @param capacity The maximum number of files whose siblings are remembered.
+ */
+void precompressed::configure(std::size_t capacity)
+{
+    capacity_ = capacity;
+}
+
+/**
+ * @brief Get the usable precompressed siblings of a file.
+ *
+ * @param path The path of the original file.
+ * @return A mask of coding bits, 0 if there are none or the file does not exist.
+ */
+unsigned precompressed::lookup(std::string const& path)
+{
+    if(! enabled_)
+        return 0;
+
+    std::uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(path);
+        if(it != entries_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            return it->second.mask;
+        }
+        generation = generation_;
+    }
+
+    // Watch before probing so that a change in between invalidates the result.
+    auto const slash = path.rfind('/');
+    auto const directory = slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    auto& watcher = file_watcher::instance();
+    if(! watcher.watch(path) || ! watcher.watch(directory))
+        return 0;
+
+    bool exists = false;
+    unsigned const mask = probe(path, exists);
+
+    // Only remember files that exist, so requests for missing paths cannot grow the index.
+    if(! exists)
+        return 0;
+
+    for(auto const& v : variants)
+        if(mask & v.bit)
+            watcher.watch(path + v.suffix);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(capacity_ != 0 && generation == generation_ && entries_.find(path) == entries_.end())
+    {
+        lru_.push_front(path);
+        entries_.emplace(path, slot{mask, lru_.begin()});
+        directories_[directory].push_back(path);
+        for(auto const& v : variants)
+            if(mask & v.bit)
+                owners_[path + v.suffix] = path;
+        if(entries_.size() > capacity_)
+            erase(entries_.find(lru_.back()));
+    }
+    return mask;
+}
+
+/**
+ * @brief Remove a cached path, its siblings and its directory's reference to it.
+ *
+ * Must be called with mutex_ held.
+ */
+void precompressed::erase(std::unordered_map<std::string, slot>::iterator it)
+{
+    auto const& path = it->first;
+    for(auto const& v : variants)
+        if(it->second.mask & v.bit)
+            owners_.erase(path + v.suffix);
+
+    auto const slash = path.rfind('/');
+    if(auto dir = directories_.find(slash == std::string::npos ? std::string(".") : path.substr(0, slash));
+        dir != directories_.end())
+    {
+        auto& files = dir->second;
+        files.erase(std::remove(files.begin(), files.end(), path), files.end());
+        if(files.empty())
+            directories_.erase(dir);
+    }
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
+
+/**
+ * @brief Drop cached lookups for a changed path.
+ *
+ * @param path A file, a directory (drops every file in it), or an empty string for all.
+ */
+void precompressed::invalidate(std::string const& path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+
+    if(path.empty())
+    {
+        entries_.clear();
+        lru_.clear();
+        owners_.clear();
+        directories_.clear();
+        return;
+    }
+
+    if(auto it = entries_.find(path); it != entries_.end())
+        erase(it);
+
+    if(auto it = owners_.find(path); it != owners_.end())
+    {
+        if(auto entry = entries_.find(it->second); entry != entries_.end())
+            erase(entry);
+        else
+            owners_.erase(it);
+    }
+
+    if(auto it = directories_.find(path); it != directories_.end())
+    {
+        auto const files = std::move(it->second);
+        directories_.erase(it);
+        for(auto const& file : files)
+            if(auto entry = entries_.find(file); entry != entries_.end())
+                erase(entry);
+    }
+}
+
+/**
+ * @brief Stat a file and its siblings.
+ *
+ * @param path The path of the original file.
+ * @param exists Set to true if the original is a regular file.
+ * @return The mask of usable siblings.
+ */
+unsigned precompressed::probe(std::string const& path, bool& exists)
+{
+    struct stat original;
+    exists = ::stat(path.c_str(), &original) == 0 && S_ISREG(original.st_mode);
+    if(! exists)
+        return 0;
+
+    unsigned mask = 0;
+    for(auto const& v : variants)
+    {
+        struct stat sibling;
+        auto const name = path + v.suffix;
+        if(::stat(name.c_str(), &sibling) != 0 || ! S_ISREG(sibling.st_mode))
+            continue;
+
+        // A sibling older than the original is stale.
+        if(sibling.st_mtim.tv_sec < original.st_mtim.tv_sec
+            || (sibling.st_mtim.tv_sec == original.st_mtim.tv_sec
+                && sibling.st_mtim.tv_nsec < original.st_mtim.tv_nsec))
+            continue;
+
+        mask |= v.bit;
+    }
+    return mask;
+}
+
+/**
+ * @brief Parse an Accept-Encoding header value.
+ *
+ * Codings listed with "q=0" are refused; "*" stands for every coding not listed.
+ *
+ * @param header The header value.
+ * @return A mask of the codings the client accepts with a non-zero quality.
+ */
+unsigned precompressed::accepted(std::string_view header)
+{
+    auto const trim = [](std::string_view s)
+    {
+        while(! s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        while(! s.empty() && (s.back() == ' ' || s.back() == '\t'))
+            s.remove_suffix(1);
+        return s;
+    };
+
+    auto const iequals = [](std::string_view a, std::string_view b)
+    {
+        if(a.size() != b.size())
+            return false;
+        for(std::size_t i = 0; i < a.size(); ++i)
+            if(std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+                return false;
+        return true;
+    };
+
+    unsigned accepted = 0, listed = 0;
+    bool wildcard = false;
+
+    while(! header.empty())
+    {
+        auto const comma = header.find(',');
+        auto item = header.substr(0, comma);
+        header.remove_prefix(comma == std::string_view::npos ? header.size() : comma + 1);
+
+        auto const semicolon = item.find(';');
+        auto const name = trim(item.substr(0, semicolon));
+
+        bool refused = false;
+        if(semicolon != std::string_view::npos)
+        {
+            auto params = trim(item.substr(semicolon + 1));
+            if(params.size() > 2 && (params[0] == 'q' || params[0] == 'Q') && params[1] == '=')
+                refused = std::strtod(std::string(params.substr(2)).c_str(), nullptr) <= 0.0;
+        }
+
+        if(name == "*")
+        {
+            wildcard = ! refused;
+            continue;
+        }
+
+        static constexpr std::pair<coding, char const*> tokens[] = {
+            {br, "br"}, {zstd, "zstd"}, {gzip, "gzip"}, {gzip, "x-gzip"}, {deflate, "deflate"}};
+        for(auto const& [bit, token] : tokens)
+        {
+            if(! iequals(name, token))
+                continue;
+            listed |= bit;
+            if(! refused)
+                accepted |= bit;
+        }
+    }
+
+    if(wildcard)
+        accepted |= (br | zstd | gzip | deflate) & ~listed;
+    return accepted;
+}
+
+/**
+ * @brief Pick the variant to serve.
+ *
+ * @param available The siblings of the file.
+ * @param accepted The codings the client accepts.
+ * @return The preferred variant, or null to serve the original.
+ */
+precompressed::variant const* precompressed::choose(unsigned available, unsigned accepted)
+{
+    for(auto const& v : variants)
+        if(available & accepted & v.bit)
+            return &v;
+    return nullptr;
+}
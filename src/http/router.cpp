@@ -0,0 +1,260 @@
+#include "../../include/http/router.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * @brief A trie node while routes are being added.
+ */
+struct router::build_node
+{
+    std::string text;                                   ///< Static prefix, or parameter name
+    std::vector<std::unique_ptr<build_node>> children;  ///< Static children
+    std::unique_ptr<build_node> param;                  ///< Parameter child
+    std::vector<route> routes;                          ///< Routes ending here
+};
+
+router::router()
+    : root_(std::make_unique<build_node>())
+{
+}
+
+router::router(router&&) noexcept = default;
+router& router::operator=(router&&) noexcept = default;
+router::~router() = default;
+
+namespace {
+
+/**
+ * @brief Descend from a node along static text, splitting nodes where the text diverges.
+ *
+ * @return The node at which the text ends.
+ */
+template<class Node>
+Node* insert_static(Node* n, std::string_view text)
+{
+    while(! text.empty())
+    {
+        auto it = std::find_if(n->children.begin(), n->children.end(),
+            [&](auto const& c) { return c->text.front() == text.front(); });
+
+        if(it == n->children.end())
+        {
+            n->children.push_back(std::make_unique<Node>());
+            n->children.back()->text = std::string(text);
+            return n->children.back().get();
+        }
+
+        auto& child = *it;
+        auto const common = static_cast<std::size_t>(
+            std::mismatch(child->text.begin(), child->text.end(), text.begin(), text.end()).first
+            - child->text.begin());
+
+        if(common < child->text.size())
+        {
+            auto mid = std::make_unique<Node>();
+            mid->text = child->text.substr(0, common);
+            child->text.erase(0, common);
+            mid->children.push_back(std::move(child));
+            child = std::move(mid);
+        }
+
+        n = child.get();
+        text.remove_prefix(common);
+    }
+    return n;
+}
+
+} // namespace
+
+/**
+ * @brief Register a handler.
+ *
+ * @param method The request method the route answers.
+ * @param pattern The path pattern, starting with '/'.
+ * @param handler The handler to call for matching requests.
+ * @throws std::invalid_argument if the pattern is malformed or conflicts with a registered route.
+ */
+void router::add(http::verb method, std::string_view pattern, handler_type handler)
+{
+    if(! root_)
+        throw std::logic_error("router: add() after compile()");
+    if(pattern.empty() || pattern.front() != '/')
+        throw std::invalid_argument("router: pattern must start with '/': " + std::string(pattern));
+
+    build_node* n = root_.get();
+    bool mount = false;
+    std::size_t params = 0;
+
+    for(std::string_view rest = pattern; ! rest.empty(); )
+    {
+        if(rest.front() == '*')
+        {
+            if(rest.size() != 1)
+                throw std::invalid_argument("router: '*' must end the pattern: " + std::string(pattern));
+            mount = true;
+            break;
+        }
+
+        if(rest.front() == ':')
+        {
+            auto const end = std::min(rest.find('/'), rest.size());
+            auto const name = rest.substr(1, end - 1);
+            if(name.empty() || ++params > route_match::max_params)
+                throw std::invalid_argument("router: bad parameter in pattern: " + std::string(pattern));
+
+            if(! n->param)
+            {
+                n->param = std::make_unique<build_node>();
+                n->param->text = std::string(name);
+            }
+            else if(n->param->text != name)
+                throw std::invalid_argument("router: parameter name conflicts with ':" + n->param->text + "': " + std::string(pattern));
+
+            n = n->param.get();
+            rest.remove_prefix(end);
+            continue;
+        }
+
+        auto const end = std::min(rest.find_first_of(":*"), rest.size());
+        n = insert_static(n, rest.substr(0, end));
+        rest.remove_prefix(end);
+    }
+
+    for(auto const& r : n->routes)
+        if(r.method == method && r.mount == mount)
+            throw std::invalid_argument("router: duplicate route: " + std::string(pattern));
+
+    n->routes.push_back({method, mount, static_cast<std::uint32_t>(handlers_.size())});
+    handlers_.push_back(std::move(handler));
+}
+
+/**
+ * @brief Build the lookup trie from the registered routes.
+ */
+void router::compile()
+{
+    nodes_.clear();
+    routes_.clear();
+    text_.clear();
+
+    // Reserve the first slot so the root ends up at index 0.
+    nodes_.emplace_back();
+    auto root = std::move(root_);
+    nodes_[0] = nodes_[flatten(*root)];
+    nodes_.pop_back();
+}
+
+/**
+ * @brief Append a build node and its subtree to the compiled arrays.
+ *
+ * Children are reserved as one contiguous block before any of them is filled in,
+ * so siblings end up next to each other.
+ *
+ * @return The index of the compiled node.
+ */
+std::uint32_t router::flatten(build_node& b)
+{
+    node n;
+    n.text_offset = static_cast<std::uint32_t>(text_.size());
+    n.text_size = static_cast<std::uint32_t>(b.text.size());
+    text_ += b.text;
+
+    n.first_route = static_cast<std::uint32_t>(routes_.size());
+    n.route_count = static_cast<std::uint32_t>(b.routes.size());
+    routes_.insert(routes_.end(), b.routes.begin(), b.routes.end());
+
+    std::sort(b.children.begin(), b.children.end(),
+        [](auto const& x, auto const& y) { return x->text.front() < y->text.front(); });
+
+    n.first_child = static_cast<std::uint32_t>(nodes_.size());
+    n.child_count = static_cast<std::uint32_t>(b.children.size());
+    nodes_.resize(nodes_.size() + b.children.size());
+    for(std::size_t i = 0; i < b.children.size(); ++i)
+    {
+        auto const child = flatten(*b.children[i]);
+        nodes_[n.first_child + i] = nodes_[child];
+        nodes_.pop_back();
+    }
+
+    if(b.param)
+        n.param_child = flatten(*b.param);
+
+    nodes_.push_back(n);
+    return static_cast<std::uint32_t>(nodes_.size() - 1);
+}
+
+/**
+ * @brief Find a route of a node by method and kind.
+ */
+router::handler_type const* router::find(node const& n, http::verb method, bool mount) const
+{
+    for(auto i = n.first_route; i < n.first_route + n.route_count; ++i)
+        if(routes_[i].method == method && routes_[i].mount == mount)
+            return &handlers_[routes_[i].handler];
+    return nullptr;
+}
+
+/**
+ * @brief Find the handler for a request path.
+ *
+ * @param method The request method.
+ * @param path The request path, without the query string.
+ * @param match Receives the captured parameters and mount remainder.
+ * @return The handler, or null if no route matches.
+ */
+router::handler_type const* router::match(http::verb method, std::string_view path, route_match& match) const
+{
+    match.param_count = 0;
+    match.rest = {};
+    if(nodes_.empty())
+        return nullptr;
+    return match_node(0, path, method, match);
+}
+
+/**
+ * @brief Match the rest of a path below a node whose own text has been consumed.
+ */
+router::handler_type const* router::match_node(
+    std::uint32_t index, std::string_view path, http::verb method, route_match& m) const
+{
+    auto const& n = nodes_[index];
+
+    if(path.empty())
+    {
+        if(auto h = find(n, method, false))
+            return h;
+    }
+    else
+    {
+        // Siblings start with distinct characters, so at most one static child can match.
+        for(auto i = n.first_child; i < n.first_child + n.child_count; ++i)
+        {
+            auto const text = text_of(nodes_[i]);
+            if(text.front() != path.front())
+                continue;
+            if(path.substr(0, text.size()) == text)
+                if(auto h = match_node(i, path.substr(text.size()), method, m))
+                    return h;
+            break;
+        }
+
+        if(n.param_child != npos)
+        {
+            auto const value = path.substr(0, path.find('/'));
+            if(! value.empty())
+            {
+                m.params[m.param_count++] = {text_of(nodes_[n.param_child]), value};
+                if(auto h = match_node(n.param_child, path.substr(value.size()), method, m))
+                    return h;
+                --m.param_count;
+            }
+        }
+    }
+
+    if(auto h = find(n, method, true))
+    {
+        m.rest = path;
+        return h;
+    }
+    return nullptr;
+}
@@ -0,0 +1,251 @@
+#include "../../include/http/validators.hpp"
+#include "../../include/util/file_watcher.hpp"
+#include "../../include/util/timestamp.hpp"
+#include "../../include/log/log.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <sys/stat.h>
+
+namespace {
+
+/**
+ * @brief Strip the weakness indicator of an entity tag.
+ */
+std::string_view opaque(std::string_view etag)
+{
+    if(etag.substr(0, 2) == "W/")
+        etag.remove_prefix(2);
+    return etag;
+}
+
+} // namespace
+
+/**
+ * @brief Access the shared cache instance.
+ *
+ * @return A reference to the process-wide cache.
+ */
+validators& validators::instance()
+{
+    static validators cache;
+    return cache;
+}
+
+/**
+ * @brief Subscribe to file change notifications, or stat on every lookup without inotify.
+ */
+validators::validators()
+{
+    auto& watcher = file_watcher::instance();
+    if(! watcher.available())
+    {
+        auto logger = LoggerManager::getLogger("validators_logger", LogLevel::INFO);
+        LOG_WARN(logger, "Validator cache disabled: inotify is not available.");
+        return;
+    }
+
+    watcher.subscribe([this](std::string const& path) { invalidate(path); });
+    enabled_ = true;
+}
+
+/**
+ * @brief Choose the kind of entity tag issued and bound the cache.
+ *
+ * @param weak True to issue weak tags, false (the default) for strong ones.
+ * @param capacity The maximum number of files whose validators are kept.
+ */
+void validators::configure(bool weak, std::size_t capacity)
+{
+    weak_ = weak;
+    capacity_ = capacity;
+}
+
+/**
+ * @brief Get the validators of a file.
+ *
+ * @param path The path of the file.
+ * @return The validators, or null if the path is not a regular file.
+ */
+validators::entry_type validators::lookup(std::string const& path)
+{
+    if(! enabled_)
+        return probe(path);
+
+    std::uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(path);
+        if(it != entries_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            return it->second.value;
+        }
+        generation = generation_;
+    }
+
+    // Watch before probing so that a change in between invalidates the result.
+    auto const slash = path.rfind('/');
+    auto const directory = slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    auto& watcher = file_watcher::instance();
+    if(! watcher.watch(path) || ! watcher.watch(directory))
+        return probe(path);
+
+    // Only remember files that exist, so requests for missing paths cannot grow the cache.
+    auto result = probe(path);
+    if(! result)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(capacity_ != 0 && generation == generation_ && entries_.find(path) == entries_.end())
+    {
+        lru_.push_front(path);
+        entries_.emplace(path, slot{result, lru_.begin()});
+        directories_[directory].push_back(path);
+        if(entries_.size() > capacity_)
+            erase(entries_.find(lru_.back()));
+    }
+    return result;
+}
+
+/**
+ * @brief Remove a cached path, from its directory's list too. Must be called with mutex_ held.
+ */
+void validators::erase(std::unordered_map<std::string, slot>::iterator it)
+{
+    auto const& path = it->first;
+    auto const slash = path.rfind('/');
+    if(auto dir = directories_.find(slash == std::string::npos ? std::string(".") : path.substr(0, slash));
+        dir != directories_.end())
+    {
+        auto& files = dir->second;
+        files.erase(std::remove(files.begin(), files.end(), path), files.end());
+        if(files.empty())
+            directories_.erase(dir);
+    }
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
+
+/**
+ * @brief Drop cached validators for a changed path.
+ *
+ * @param path A file, a directory (drops every file in it), or an empty string for all.
+ */
+void validators::invalidate(std::string const& path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+
+    if(path.empty())
+    {
+        entries_.clear();
+        lru_.clear();
+        directories_.clear();
+        return;
+    }
+
+    if(auto it = entries_.find(path); it != entries_.end())
+        erase(it);
+
+    if(auto it = directories_.find(path); it != directories_.end())
+    {
+        auto const files = std::move(it->second);
+        directories_.erase(it);
+        for(auto const& file : files)
+        {
+            if(auto entry = entries_.find(file); entry != entries_.end())
+            {
+                lru_.erase(entry->second.lru);
+                entries_.erase(entry);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Stat a file and format its validators.
+ *
+ * The tag combines the inode, size and modification time in nanoseconds, so a
+ * file replaced within the same second still gets a new tag.
+ *
+ * @param path The path of the file.
+ * @return The validators, or null if the path is not a regular file.
+ */
+validators::entry_type validators::probe(std::string const& path) const
+{
+    struct stat st;
+    if(::stat(path.c_str(), &st) != 0 || ! S_ISREG(st.st_mode))
+        return nullptr;
+
+    auto result = std::make_shared<entry>();
+    result->mtime = st.st_mtim.tv_sec;
+    result->mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    result->size = static_cast<std::uint64_t>(st.st_size);
+
+    char text[80];
+    int const n = std::snprintf(text, sizeof(text), "%s\"%llx-%llx-%llx%09lx\"", weak_ ? "W/" : "",
+        static_cast<unsigned long long>(st.st_ino),
+        static_cast<unsigned long long>(st.st_size),
+        static_cast<unsigned long long>(st.st_mtim.tv_sec),
+        static_cast<unsigned long>(st.st_mtim.tv_nsec));
+    result->etag.assign(text, static_cast<std::size_t>(n));
+
+    auto const date = timestamp::http_date(timestamp::clock::from_time_t(st.st_mtim.tv_sec));
+    result->last_modified.assign(date.data(), date.size());
+    return result;
+}
+
+/**
+ * @brief Derive the tag of a representation produced from the file.
+ *
+ * @param etag The tag of the file.
+ * @param coding The Content-Encoding token of the representation, or null for the file itself.
+ * @return The tag, with the coding appended inside the quotes.
+ */
+std::string validators::tag(std::string const& etag, char const* coding)
+{
+    if(! coding || etag.empty())
+        return etag;
+
+    std::string result(etag, 0, etag.size() - 1);
+    result.append("-").append(coding).append("\"");
+    return result;
+}
+
+/**
+ * @brief Evaluate an If-None-Match header value with the weak comparison.
+ *
+ * @param header The header value, "*" or a list of entity tags.
+ * @param etag The current tag of the representation.
+ * @return True if one of the listed tags matches.
+ */
+bool validators::none_match(std::string_view header, std::string_view etag)
+{
+    auto const current = opaque(etag);
+
+    while(! header.empty())
+    {
+        auto const comma = header.find(',');
+        auto item = header.substr(0, comma);
+        header.remove_prefix(comma == std::string_view::npos ? header.size() : comma + 1);
+
+        while(! item.empty() && (item.front() == ' ' || item.front() == '\t'))
+            item.remove_prefix(1);
+        while(! item.empty() && (item.back() == ' ' || item.back() == '\t'))
+            item.remove_suffix(1);
+
+        if(item == "*" || opaque(item) == current)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Compare two entity tags with the strong comparison, as If-Range requires.
+ *
+ * @return True if both are strong and identical.
+ */
+bool validators::strong_match(std::string_view a, std::string_view b)
+{
+    return a.substr(0, 2) != "W/" && a.size() > 1 && a.front() == '"' && a == b;
+}
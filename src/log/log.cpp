@@ -1,11 +1,254 @@
 #include "../../include/log/log.hpp"
+#include "../../include/util/timestamp.hpp"
 #include <iostream>
-#include <iomanip>
-#include <ctime>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
 
 // Static member initialization
 std::mutex LoggerManager::mutex_;
 std::map<std::string, std::shared_ptr<Logger>> LoggerManager::loggers_;
+bool LoggerManager::async_ = false;
+std::atomic<std::uint64_t> Logger::nextId_{1};
+
+/**
+ * @brief A descriptor used for asynchronous output.
+ *
+ * Loggers and queued records share ownership, so a descriptor replaced by
+ * setOutput() is only closed after the last record addressed to it is written,
+ * and its number cannot be reused for another file or socket in the meantime.
+ */
+struct LogDescriptor {
+    int fd;         ///< The descriptor
+    bool owned;     ///< Whether to close it, false for standard output
+
+    ~LogDescriptor() {
+        if (owned) {
+            ::close(fd);
+        }
+    }
+};
+
+namespace {
+
+/**
+ * @brief Background writer shared by all asynchronous loggers.
+ *
+ * Producers push records into a bounded lock-free MPSC ring and never wait; a single
+ * thread drains the ring, formats the records and writes each batch with one write(2)
+ * per destination descriptor.
+ */
+class AsyncLogWriter {
+public:
+    /// A queued log line, formatted by the writer thread.
+    struct Record {
+        std::shared_ptr<const LogDescriptor> out;           ///< Destination descriptor
+        bool hasLevel = false;                              ///< Whether to print level and name
+        LogLevel level = LogLevel::INFO;                    ///< Level of the message
+        const std::string* name = nullptr;                  ///< Name of the logger
+        std::chrono::system_clock::time_point time;         ///< When the message was logged
+        std::string message;                                ///< The message text
+        bool raw = false;                                   ///< Write the message verbatim
+    };
+
+    /**
+     * @brief Returns the process-wide writer, starting its thread on first use.
+     *
+     * The writer is never destroyed so that loggers outliving static destruction can
+     * still flush; pending records are drained at exit.
+     */
+    static AsyncLogWriter& instance() {
+        static AsyncLogWriter* writer = [] {
+            auto* w = new AsyncLogWriter;
+            std::atexit([] { instance().flush(); });
+            return w;
+        }();
+        return *writer;
+    }
+
+    /**
+     * @brief Queues a record without blocking.
+     * @return False if the ring was full and the record was dropped.
+     */
+    bool push(Record&& record) {
+        std::size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask];
+            std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->record = std::move(record);
+        cell->seq.store(pos + 1, std::memory_order_release);
+
+        // Pairs with the writer's store to sleeping_ and its wait on signal_: either
+        // the writer sees this bump and does not block, or this load sees it sleeping.
+        // Both sides must be seq_cst, since acquire/release allows each thread's load to
+        // miss the other's store. On x86 the RMW is a full barrier anyway.
+        signal_.fetch_add(1, std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_seq_cst))
+            signal_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Waits until every record queued before the call has been written.
+     */
+    void flush() {
+        std::size_t target = enqueuePos_.load(std::memory_order_acquire);
+        while (written_.load(std::memory_order_acquire) < target)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+private:
+    static constexpr std::size_t capacity = 8192;           ///< Ring size, a power of two
+    static constexpr std::size_t mask = capacity - 1;
+    static constexpr std::size_t maxBatch = 256;            ///< Records formatted per write
+
+    /// A ring slot with its sequence number.
+    struct Cell {
+        std::atomic<std::size_t> seq;
+        Record record;
+    };
+
+    AsyncLogWriter() : cells_(capacity) {
+        for (std::size_t i = 0; i < capacity; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        std::thread([this] { run(); }).detach();
+    }
+
+    /**
+     * @brief Pops the next record if one is ready. Only called by the writer thread.
+     */
+    bool pop(Record& record) {
+        Cell& cell = cells_[dequeuePos_ & mask];
+        if (cell.seq.load(std::memory_order_acquire) != dequeuePos_ + 1)
+            return false;
+        record = std::move(cell.record);
+        cell.seq.store(dequeuePos_ + capacity, std::memory_order_release);
+        ++dequeuePos_;
+        return true;
+    }
+
+    /**
+     * @brief Appends a formatted record to the batch for its descriptor.
+     */
+    void format(const Record& record) {
+        std::string* out = nullptr;
+        for (auto& batch : batches_) {
+            if (batch.first == record.out) {
+                out = &batch.second;
+                break;
+            }
+        }
+        if (!out) {
+            batches_.emplace_back(record.out, std::string());
+            out = &batches_.back().second;
+        }
+
+        if (record.raw) {
+            out->append(record.message);
+            return;
+        }
+
+        out->append(timestamp::local(record.time)).append(" - ");
+        if (record.hasLevel) {
+            out->append(levelName(record.level)).append(" [").append(*record.name).append("] ");
+        }
+        out->append(record.message).push_back('\n');
+    }
+
+    /**
+     * @brief Writes out every pending batch, one write(2) per descriptor.
+     */
+    void writeBatches() {
+        static const std::string name = "logger";
+        std::size_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped && !batches_.empty()) {
+            format({batches_.front().first, true, LogLevel::WARN, &name, std::chrono::system_clock::now(),
+                    std::to_string(dropped) + " messages dropped, log queue full"});
+        }
+
+        for (auto& batch : batches_) {
+            const char* data = batch.second.data();
+            std::size_t left = batch.second.size();
+            while (left > 0) {
+                ssize_t n = ::write(batch.first->fd, data, left);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    break;
+                }
+                data += n;
+                left -= static_cast<std::size_t>(n);
+            }
+        }
+        // Release the descriptors; a replaced one is closed here once its lines are out.
+        batches_.clear();
+    }
+
+    /**
+     * @brief Writer thread loop: drain, format, write, then sleep until signalled.
+     */
+    void run() {
+        Record record;
+        for (;;) {
+            unsigned seen = signal_.load(std::memory_order_acquire);
+
+            std::size_t count = 0;
+            while (count < maxBatch && pop(record)) {
+                format(record);
+                ++count;
+            }
+
+            if (count > 0) {
+                writeBatches();
+                written_.fetch_add(count, std::memory_order_release);
+                continue;
+            }
+
+            // See push() for why this handshake is seq_cst.
+            sleeping_.store(true, std::memory_order_seq_cst);
+            if (cells_[dequeuePos_ & mask].seq.load(std::memory_order_acquire) != dequeuePos_ + 1)
+                signal_.wait(seen, std::memory_order_acquire);
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    static const char* levelName(LogLevel level) {
+        switch (level) {
+            case LogLevel::DEBUG: return "DEBUG";
+            case LogLevel::INFO: return "INFO";
+            case LogLevel::WARN: return "WARN";
+            case LogLevel::ERROR: return "ERROR";
+            default: return "UNKNOWN";
+        }
+    }
+
+    std::vector<Cell> cells_;                                   ///< The ring
+    alignas(64) std::atomic<std::size_t> enqueuePos_{0};        ///< Next slot claimed by producers
+    alignas(64) std::size_t dequeuePos_ = 0;                    ///< Next slot read by the writer
+    alignas(64) std::atomic<std::size_t> written_{0};           ///< Records written so far
+    std::atomic<std::size_t> dropped_{0};                       ///< Records dropped since the last batch
+    std::atomic<unsigned> signal_{0};                           ///< Bumped on every push to wake the writer
+    std::atomic<bool> sleeping_{false};                         ///< Whether the writer is waiting
+    std::vector<std::pair<std::shared_ptr<const LogDescriptor>, std::string>> batches_; ///< Formatted output per descriptor
+};
+
+} // namespace
 
 /**
  * @brief Constructs a Logger object.
@@ -20,7 +263,8 @@ std::map<std::string, std::shared_ptr<Logger>> LoggerManager::loggers_;
  * @throws std::runtime_error if the log file cannot be opened.
  */
 Logger::Logger(const std::string& name, LogLevel level, LogOutput output, const std::string& filename)
-    : name_(name), level_(level), output_(output) {
+    : name_(name), level_(level), output_(output), filename_(filename),
+      id_(nextId_.fetch_add(1, std::memory_order_relaxed)) {
     if (output_ == LogOutput::FILE && !filename.empty()) {
         file_.open(filename, std::ios::app);
         if (!file_.is_open()) {
@@ -35,6 +279,9 @@ Logger::Logger(const std::string& name, LogLevel level, LogOutput output, const
  * Closes the log file if it is open.
  */
 Logger::~Logger() {
+    if (async_) {
+        AsyncLogWriter::instance().flush();
+    }
     if (file_.is_open()) {
         file_.close();
     }
@@ -50,12 +297,36 @@ Logger::~Logger() {
  * @param message The message to log.
  */
 void Logger::log(LogLevel level, const std::string& message) {
-    if (level >= level_) {
+    if (isEnabled(level)) {
+        if (async_) {
+            AsyncLogWriter::instance().push({fd_.load(), true, level, &name_, std::chrono::system_clock::now(), message});
+            return;
+        }
         std::lock_guard<std::mutex> lock(mutex_);
         writeToOutput(levelToString(level) + " [" + name_ + "] " + message);
     }
 }
 
+/**
+ * @brief Writes preformatted text as-is, without timestamp or level prefix.
+ *
+ * @param text The text to write, normally one or more newline-terminated lines.
+ */
+void Logger::writeRaw(std::string text) {
+    if (async_) {
+        AsyncLogWriter::instance().push({fd_.load(), false, LogLevel::INFO, &name_, {}, std::move(text), true});
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (output_ == LogOutput::CONSOLE) {
+        std::cout << text << std::flush;
+    } else if (output_ == LogOutput::FILE && file_.is_open()) {
+        file_.write(text.data(), text.size());
+        file_.flush();
+    }
+}
+
 /**
  * @brief Sets the log level for the logger.
  * 
@@ -81,11 +352,61 @@ void Logger::setOutput(LogOutput output, const std::string& filename) {
     std::lock_guard<std::mutex> lock(mutex_);
     output_ = output;
     if (output_ == LogOutput::FILE && !filename.empty()) {
+        filename_ = filename;
         file_.open(filename, std::ios::app);
         if (!file_.is_open()) {
             throw std::runtime_error("Failed to open log file: " + filename);
         }
     }
+    if (async_) {
+        openAsyncOutput();
+    }
+}
+
+/**
+ * @brief Switches between synchronous and asynchronous output.
+ *
+ * Pending asynchronous messages are flushed before switching back to synchronous
+ * output so that lines are not reordered.
+ *
+ * @param async True to enable asynchronous output.
+ * @throws std::runtime_error if the log file cannot be opened for asynchronous writes.
+ */
+void Logger::setAsync(bool async) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (async == async_) {
+        return;
+    }
+    if (async) {
+        openAsyncOutput();
+        if (file_.is_open()) {
+            file_.flush();
+        }
+    } else {
+        AsyncLogWriter::instance().flush();
+    }
+    async_ = async;
+}
+
+/**
+ * @brief Opens or selects the descriptor used for asynchronous output.
+ *
+ * Console output goes to standard output; file output gets its own append-mode
+ * descriptor so that batches can be written with a single write(2). The previous
+ * descriptor stays open until the records already queued for it are written.
+ *
+ * @throws std::runtime_error if the log file cannot be opened.
+ */
+void Logger::openAsyncOutput() {
+    if (output_ == LogOutput::FILE && !filename_.empty()) {
+        int fd = ::open(filename_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open log file: " + filename_);
+        }
+        fd_ = std::shared_ptr<const LogDescriptor>(new LogDescriptor{fd, true});
+        return;
+    }
+    fd_ = std::shared_ptr<const LogDescriptor>(new LogDescriptor{STDOUT_FILENO, false});
 }
 
 /**
@@ -107,20 +428,18 @@ std::string Logger::levelToString(LogLevel level) {
 /**
  * @brief Writes a formatted message to the configured output (console or file).
  * 
- * The message is prefixed with the current timestamp.
+ * The message is prefixed with the current timestamp, taken from the per-second cache.
  * 
  * @param message The message to write.
  */
 void Logger::writeToOutput(const std::string& message) {
-    std::ostringstream oss;
-    auto t = std::time(nullptr);
-    auto tm = *std::localtime(&t);
-    oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S") << " - " << message;
+    std::string line(timestamp::local());
+    line.append(" - ").append(message);
 
     if (output_ == LogOutput::CONSOLE) {
-        std::cout << oss.str() << std::endl;
+        std::cout << line << std::endl;
     } else if (output_ == LogOutput::FILE && file_.is_open()) {
-        file_.write(oss.str().c_str(), oss.str().length());
+        file_.write(line.c_str(), line.length());
         file_ << std::endl;
     }
 }
@@ -129,18 +448,61 @@ void Logger::writeToOutput(const std::string& message) {
  * @brief Operator overload to handle streaming to the logger.
  * 
  * This allows you to use the logger with stream syntax (e.g., `logger << "message";`).
+ * The manipulator commits the calling thread's buffered message: a single push into
+ * the asynchronous queue, or a single locked write in synchronous mode.
  * 
  * @param os The output stream manipulator (e.g., std::endl).
  * @return A reference to the Logger object.
  */
 Logger& Logger::operator<<(std::ostream& (*os)(std::ostream&)) {
+    (void)os;
+    std::ostringstream& buffer = threadBuffer();
+    std::string message = buffer.str();
+    buffer.str("");
+    buffer.clear();
+
+    if (async_) {
+        AsyncLogWriter::instance().push({fd_.load(), false, LogLevel::INFO, &name_, std::chrono::system_clock::now(), std::move(message)});
+        return *this;
+    }
+
     std::lock_guard<std::mutex> lock(mutex_);
-    writeToOutput(buffer_.str());
-    buffer_.str("");
-    buffer_.clear();
+    writeToOutput(message);
     return *this;
 }
 
+/**
+ * @brief Returns the calling thread's buffer for messages streamed into this logger.
+ *
+ * Buffers are kept per thread and per logger, and reused across messages. They are
+ * keyed by the logger's id rather than its address, which a new logger may reuse
+ * after another is destroyed. The last lookup is cached since a thread usually
+ * streams a whole message into one logger.
+ *
+ * @return The thread-local message buffer.
+ */
+std::ostringstream& Logger::threadBuffer() {
+    thread_local std::map<std::uint64_t, std::ostringstream> buffers;
+    thread_local std::uint64_t lastLogger = 0;
+    thread_local std::ostringstream* lastBuffer = nullptr;
+
+    if (lastLogger != id_) {
+        lastBuffer = &buffers[id_];
+        lastLogger = id_;
+    }
+    return *lastBuffer;
+}
+
+/**
+ * @brief Returns the calling thread's scratch buffer for logf().
+ *
+ * @return The thread-local formatting buffer.
+ */
+std::ostringstream& Logger::formatBuffer() {
+    thread_local std::ostringstream buffer;
+    return buffer;
+}
+
 /**
  * @brief Retrieves a logger instance by name.
  * 
@@ -156,7 +518,23 @@ std::shared_ptr<Logger> LoggerManager::getLogger(const std::string& name, LogLev
     std::lock_guard<std::mutex> lock(mutex_);
     if (loggers_.find(name) == loggers_.end()) {
         loggers_[name] = std::make_shared<Logger>(name, level, output, filename);
+        if (async_) {
+            loggers_[name]->setAsync(true);
+        }
     }
     return loggers_[name];
 }
 
+/**
+ * @brief Switches all existing and future loggers to asynchronous or synchronous output.
+ *
+ * @param async True to enable asynchronous output.
+ */
+void LoggerManager::setAsync(bool async) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    async_ = async;
+    for (auto& entry : loggers_) {
+        entry.second->setAsync(async);
+    }
+}
+
@@ -1,13 +1,49 @@
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <queue>
 #include <string>
 #include <thread>
 #include <vector>
+#include <pthread.h>
+#include <sched.h>
 
 // Include the new headers
 #include "../include/util/server_certificate.hpp"
 #include "../include/http/listener.hpp"
+#include "../include/http/file_cache.hpp"
+#include "../include/http/fd_cache.hpp"
+#include "../include/http/file_io.hpp"
+#include "../include/http/access_log.hpp"
+#include "../include/http/compression.hpp"
+#include "../include/http/validators.hpp"
+#include "../include/http/precompressed.hpp"
+#include "../include/http/admin_access.hpp"
+#include "../include/util/metrics.hpp"
+#include "../include/util/file_watcher.hpp"
+#include "../include/util/tls_resumption.hpp"
+#include "../include/util/crypto_pool.hpp"
+#include "../include/util/sni_certificates.hpp"
+#include "../include/util/tls_context.hpp"
+#include "../include/util/tls_records.hpp"
+
+// Pin the calling thread to the n-th CPU the process is allowed to run on.
+static void pin_to_core(int n)
+{
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+        return;
+
+    int core = -1;
+    for(int skip = n % CPU_COUNT(&allowed); skip >= 0; --skip)
+        do ++core; while(! CPU_ISSET(core, &allowed));
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
 
 int main(int argc, char* argv[])
 {
@@ -24,38 +60,176 @@ int main(int argc, char* argv[])
     auto const doc_root = std::make_shared<std::string>(argv[3]);
     auto const threads = std::max<int>(1, std::atoi(argv[4]));
 
-    net::io_context ioc{threads};
+    // Load the settings below from .env.
+    dotenv::init(".env");
+
+    // Run TLS handshakes on CRYPTO_THREADS dedicated threads instead of the I/O threads.
+    crypto_pool::instance().configure(std::strtoull(dotenv::getenv("CRYPTO_THREADS", "0").c_str(), nullptr, 10));
+
+    // Session resumption: SSL_SESSION_CACHE_SIZE sessions in the sharded server-side cache,
+    // and ticket keys regenerated every SSL_TICKET_ROTATION seconds (0 disables either).
+    tls_resumption::instance().configure(
+        std::strtoull(dotenv::getenv("SSL_SESSION_CACHE_SIZE", "20480").c_str(), nullptr, 10),
+        std::chrono::seconds(std::strtoull(dotenv::getenv("SSL_TICKET_ROTATION", "3600").c_str(), nullptr, 10)));
+
+    // Dynamic TLS record sizing: one-segment records (TLS_RECORD_SIZE bytes, or sized from the
+    // connection's MSS) for the first TLS_RECORD_BOOST_BYTES a connection sends and again after
+    // TLS_RECORD_IDLE_MS without sending, full-size records otherwise (TLS_DYNAMIC_RECORDS=1).
+    if(dotenv::getenv("TLS_DYNAMIC_RECORDS") == "1")
+        tls_records::instance().configure(
+            std::strtoull(dotenv::getenv("TLS_RECORD_SIZE", "0").c_str(), nullptr, 10),
+            std::strtoull(dotenv::getenv("TLS_RECORD_BOOST_BYTES", "1048576").c_str(), nullptr, 10),
+            std::chrono::milliseconds(std::strtoull(dotenv::getenv("TLS_RECORD_IDLE_MS", "1000").c_str(), nullptr, 10)));
+
+    // The SSL context, rebuilt on SIGHUP and, with CERT_WATCH=1, when CERT_PATH, KEY_PATH
+    // or CERT_DIR change. Certificates chosen by server name: every <name>.crt/<name>.key
+    // pair in CERT_DIR, owned by the context they are selected from.
+    std::vector<std::string> cert_paths;
+    if(dotenv::getenv("CERT_WATCH") == "1")
+        for(auto const* name : {"CERT_PATH", "KEY_PATH", "CERT_DIR"})
+            if(auto path = dotenv::getenv(name); ! path.empty())
+                cert_paths.push_back(std::move(path));
+
+    tls_context::instance().configure(
+        []
+        {
+            struct server_tls
+            {
+                ssl::context ctx{ssl::context::tlsv12};
+                sni_certificates sni;
+            };
+            auto tls = std::make_shared<server_tls>();
+
+            load_server_certificate(tls->ctx);
+            tls_resumption::instance().apply(tls->ctx.native_handle());
+            if(auto const cert_dir = dotenv::getenv("CERT_DIR"); ! cert_dir.empty())
+                tls->sni.load(
+                    cert_dir, load_file_content(dotenv::getenv("DH_PATH")), dotenv::getenv("SSL_PASSWORD"), tls->ctx);
+
+            return std::shared_ptr<ssl::context>(tls, &tls->ctx);
+        },
+        std::move(cert_paths));
+
+    // Move console and file logging off the I/O threads when LOG_ASYNC=1.
+    if(dotenv::getenv("LOG_ASYNC") == "1")
+        LoggerManager::setAsync(true);
+
+    // Opt-in static file cache, sized in bytes by FILE_CACHE_SIZE (loaded from .env above).
+    file_cache::instance().configure(
+        std::strtoull(dotenv::getenv("FILE_CACHE_SIZE", "0").c_str(), nullptr, 10),
+        std::strtoull(dotenv::getenv("FILE_CACHE_MAX_FILE_SIZE", "1048576").c_str(), nullptr, 10));
+
+    // Opt-in cache of open files (FD_CACHE_SIZE descriptors), revalidated by inotify or
+    // after FD_CACHE_TTL_MS milliseconds without it. Cached files between MMAP_MIN_SIZE
+    // and MMAP_MAX_SIZE bytes are sent from a shared mapping when sendfile cannot be used.
+    fd_cache::instance().configure(
+        std::strtoull(dotenv::getenv("FD_CACHE_SIZE", "0").c_str(), nullptr, 10),
+        std::chrono::milliseconds(std::strtoull(dotenv::getenv("FD_CACHE_TTL_MS", "1000").c_str(), nullptr, 10)),
+        std::strtoull(dotenv::getenv("MMAP_MIN_SIZE", "65536").c_str(), nullptr, 10),
+        std::strtoull(dotenv::getenv("MMAP_MAX_SIZE", "0").c_str(), nullptr, 10));
+
+    // Handle requests and read file bodies that cannot use sendfile on
+    // FILE_IO_THREADS dedicated threads.
+    file_io::instance().configure(std::strtoull(dotenv::getenv("FILE_IO_THREADS", "0").c_str(), nullptr, 10));
 
-    ssl::context ctx{ssl::context::tlsv12};
+    // On-the-fly gzip/deflate for textual files without a precompressed variant (COMPRESSION=1).
+    if(dotenv::getenv("COMPRESSION") == "1")
+        compression::instance().configure(
+            std::strtoull(dotenv::getenv("COMPRESSION_MIN_SIZE", "1024").c_str(), nullptr, 10),
+            std::strtoull(dotenv::getenv("COMPRESSION_CACHE_SIZE", "16777216").c_str(), nullptr, 10),
+            std::strtoull(dotenv::getenv("COMPRESSION_CACHE_MAX_FILE_SIZE", "1048576").c_str(), nullptr, 10));
 
-    load_server_certificate(ctx);
+    // Entity tags are strong unless ETAG_WEAK=1. The validators of VALIDATORS_CACHE_SIZE files
+    // and the precompressed siblings of PRECOMPRESSED_CACHE_SIZE files are remembered.
+    validators::instance().configure(
+        dotenv::getenv("ETAG_WEAK") == "1",
+        std::strtoull(dotenv::getenv("VALIDATORS_CACHE_SIZE", "10000").c_str(), nullptr, 10));
+    precompressed::instance().configure(
+        std::strtoull(dotenv::getenv("PRECOMPRESSED_CACHE_SIZE", "10000").c_str(), nullptr, 10));
 
-    std::make_shared<listener>(
-        ioc,
-        ctx,
-        tcp::endpoint{address, port},
-        doc_root)->run();
+    // At most FILE_WATCH_LIMIT paths are watched for changes; the oldest watches are dropped first.
+    file_watcher::instance().configure(
+        std::strtoull(dotenv::getenv("FILE_WATCH_LIMIT", "65536").c_str(), nullptr, 10));
 
-    net::signal_set signals(ioc, SIGINT, SIGTERM);
+    // Structured access log, written in batches to the file named by ACCESS_LOG.
+    if(auto const access_log_path = dotenv::getenv("ACCESS_LOG"); ! access_log_path.empty())
+        access_log::instance().configure(
+            LoggerManager::getLogger("access_log", LogLevel::INFO, LogOutput::FILE, access_log_path));
+
+    // Only clients in ADMIN_ALLOW (addresses or CIDR networks) may read /metrics and /admin/latency.
+    admin_access::instance().configure(dotenv::getenv("ADMIN_ALLOW", "127.0.0.1,::1"));
+
+    // Compile the route table before any request arrives.
+    routes();
+
+    // With SHARDED=1 every thread gets its own io_context and SO_REUSEPORT listener,
+    // pinned to a core, so the kernel spreads accepts and connections stay on one thread.
+    // Otherwise all threads share a single io_context and listener.
+    bool const sharded = dotenv::getenv("SHARDED") == "1";
+
+    std::vector<std::unique_ptr<net::io_context>> shards;
+    for(int i = 0; i < (sharded ? threads : 1); ++i)
+    {
+        shards.push_back(std::make_unique<net::io_context>(sharded ? 1 : threads));
+
+        std::make_shared<listener>(
+            *shards.back(),
+            tls_context::instance(),
+            tcp::endpoint{address, port},
+            doc_root,
+            sharded)->run();
+    }
+
+    net::signal_set signals(*shards.front(), SIGINT, SIGTERM);
     signals.async_wait(
         [&](beast::error_code const&, int)
         {
-            ioc.stop();
+            for(auto& ioc : shards)
+                ioc->stop();
         });
 
+    // SIGUSR1 dumps the per-stage latency percentiles. Merging every thread's histograms
+    // runs on a thread of its own, so no I/O thread pauses for it.
+    auto const metrics_logger = LoggerManager::getLogger("metrics_logger", LogLevel::INFO);
+    net::thread_pool dump_thread(1);
+    net::signal_set dump_signals(dump_thread, SIGUSR1);
+    std::function<void(beast::error_code const&, int)> dump_latency =
+        [&](beast::error_code const& ec, int)
+        {
+            if(ec)
+                return;
+            LOG_INFO(metrics_logger, "Stage latencies:\n", metrics::render_stages());
+            dump_signals.async_wait(dump_latency);
+        };
+    dump_signals.async_wait(dump_latency);
+
+    // SIGHUP reloads the certificates without dropping established connections.
+    net::signal_set reload_signals(*shards.front(), SIGHUP);
+    std::function<void(beast::error_code const&, int)> reload_certificates =
+        [&](beast::error_code const& ec, int)
+        {
+            if(ec)
+                return;
+            tls_context::instance().reload();
+            reload_signals.async_wait(reload_certificates);
+        };
+    reload_signals.async_wait(reload_certificates);
+
+    auto run_thread = [&](int i)
+    {
+        if(sharded)
+            pin_to_core(i);
+        shards[sharded ? i : 0]->run();
+    };
+
     std::vector<std::thread> v;
     v.reserve(threads - 1);
     for(auto i = threads - 1; i > 0; --i)
-        v.emplace_back(
-        [&ioc]
-        {
-            ioc.run();
-        });
-    ioc.run();
+        v.emplace_back(run_thread, i);
+    run_thread(0);
 
     for(auto& t : v)
         t.join();
 
     return EXIT_SUCCESS;
 }
-
@@ -0,0 +1,41 @@
+#include "../../include/util/crypto_pool.hpp"
+#include "../../include/log/log.hpp"
+
+/**
+ * @brief Access the shared pool instance.
+ *
+ * @return A reference to the process-wide pool.
+ */
+crypto_pool& crypto_pool::instance()
+{
+    static crypto_pool pool;
+    return pool;
+}
+
+/**
+ * @brief Start the crypto threads.
+ *
+ * @param threads The number of crypto threads, 0 to keep handshakes on the I/O threads.
+ */
+void crypto_pool::configure(std::size_t threads)
+{
+    if(threads == 0 || pool_)
+        return;
+
+    pool_ = std::make_unique<net::thread_pool>(threads);
+
+    auto logger = LoggerManager::getLogger("crypto_pool_logger", LogLevel::INFO);
+    LOG_INFO(logger, "TLS handshakes offloaded to ", threads, " crypto threads.");
+}
+
+/**
+ * @brief Stop accepting work and wait for the handshakes in progress.
+ */
+crypto_pool::~crypto_pool()
+{
+    if(pool_)
+    {
+        pool_->stop();
+        pool_->join();
+    }
+}
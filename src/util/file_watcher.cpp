@@ -0,0 +1,252 @@
+#include "../../include/util/file_watcher.hpp"
+#include "../../include/log/log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+
+// Events after which cached data for a file can no longer be trusted. For a
+// watched directory, IN_CREATE and IN_MOVED_TO report new entries in it.
+constexpr std::uint32_t watch_mask =
+    IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF |
+    IN_CREATE | IN_MOVED_TO | IN_ONESHOT;
+
+} // namespace
+
+/**
+ * @brief Access the shared watcher instance.
+ * 
+ * The instance is created on first use, which starts the watcher thread.
+ * 
+ * @return A reference to the process-wide watcher.
+ */
+file_watcher& file_watcher::instance() {
+    static file_watcher watcher;
+    return watcher;
+}
+
+/**
+ * @brief Initializes inotify and starts the watcher thread.
+ * 
+ * If inotify is not available the watcher stays inert and watch() always fails.
+ */
+file_watcher::file_watcher() {
+    auto logger = LoggerManager::getLogger("file_watcher_logger", LogLevel::INFO);
+
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd_ < 0 || stop_fd_ < 0) {
+        LOG_WARN(logger, "inotify unavailable: ", std::strerror(errno));
+        if (fd_ >= 0) ::close(fd_);
+        if (stop_fd_ >= 0) ::close(stop_fd_);
+        fd_ = stop_fd_ = -1;
+        return;
+    }
+
+    thread_ = std::thread([this] { run(); });
+}
+
+/**
+ * @brief Stops the watcher thread and closes the descriptors.
+ */
+file_watcher::~file_watcher() {
+    if (thread_.joinable()) {
+        std::uint64_t one = 1;
+        if (::write(stop_fd_, &one, sizeof(one)) < 0) {
+            // Nothing sensible to do during shutdown.
+        }
+        thread_.join();
+    }
+    if (fd_ >= 0) ::close(fd_);
+    if (stop_fd_ >= 0) ::close(stop_fd_);
+}
+
+bool file_watcher::available() const {
+    return fd_ >= 0;
+}
+
+/**
+ * @brief Bound the number of watched paths.
+ * 
+ * @param capacity The maximum number of paths watched at once.
+ */
+void file_watcher::configure(std::size_t capacity) {
+    capacity_ = std::max<std::size_t>(capacity, 1);
+}
+
+/**
+ * @brief Watch a file until its next modification, removal or rename.
+ * 
+ * Watching the same file again before it changes is harmless; the kernel
+ * returns the existing watch descriptor.
+ * 
+ * @param path The path of the file to watch.
+ * @param pinned Whether the watch is exempt from the limit.
+ * @return True if the watch was installed.
+ */
+bool file_watcher::watch(std::string const& path, bool pinned) {
+    if (fd_ < 0) {
+        return false;
+    }
+
+    std::string evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int wd = inotify_add_watch(fd_, path.c_str(), watch_mask);
+        if (wd < 0) {
+            return false;
+        }
+
+        // The path may now name another file than the one it was watched for.
+        if (auto it = watched_.find(path); it != watched_.end()) {
+            if (it->second.wd == wd) {
+                // A pin, once requested, is kept until the watch fires.
+                if (it->second.pinned) {
+                    return true;
+                }
+                if (pinned) {
+                    lru_.erase(it->second.lru);
+                    it->second.lru = lru_.end();
+                    it->second.pinned = true;
+                } else {
+                    lru_.splice(lru_.begin(), lru_, it->second.lru);
+                }
+                return true;
+            }
+            forget(path);
+        }
+
+        paths_[wd].push_back(path);
+        if (pinned) {
+            watched_.emplace(path, watched{wd, lru_.end(), true});
+        } else {
+            lru_.push_front(path);
+            watched_.emplace(path, watched{wd, lru_.begin(), false});
+        }
+
+        if (lru_.size() > capacity_) {
+            evicted = lru_.back();
+            forget(evicted);
+        }
+    }
+
+    // Nothing will report changes to the dropped path any more.
+    if (!evicted.empty()) {
+        notify(evicted);
+    }
+    return true;
+}
+
+/**
+ * @brief Forget a watched path, removing its watch if no other path uses it.
+ * 
+ * Must be called with mutex_ held.
+ */
+void file_watcher::forget(std::string const& path) {
+    auto it = watched_.find(path);
+    if (it == watched_.end()) {
+        return;
+    }
+
+    if (auto wd = paths_.find(it->second.wd); wd != paths_.end()) {
+        auto& paths = wd->second;
+        paths.erase(std::remove(paths.begin(), paths.end(), path), paths.end());
+        if (paths.empty()) {
+            inotify_rm_watch(fd_, wd->first);
+            paths_.erase(wd);
+        }
+    }
+    if (!it->second.pinned) {
+        lru_.erase(it->second.lru);
+    }
+    watched_.erase(it);
+}
+
+/**
+ * @brief Register a callback for change notifications.
+ * 
+ * @param cb The callback to invoke on the watcher thread.
+ */
+void file_watcher::subscribe(callback cb) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callbacks_.push_back(std::move(cb));
+}
+
+/**
+ * @brief Invoke all subscribers for a changed path.
+ * 
+ * @param path The changed path, or an empty string for all paths.
+ */
+void file_watcher::notify(std::string const& path) {
+    std::vector<callback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callbacks = callbacks_;
+    }
+    for (auto const& cb : callbacks) {
+        cb(path);
+    }
+}
+
+/**
+ * @brief Event loop run by the watcher thread.
+ * 
+ * Waits for inotify events or the shutdown signal, and translates each event
+ * into subscriber notifications for the paths registered under its watch.
+ */
+void file_watcher::run() {
+    alignas(inotify_event) char buf[4096];
+
+    for (;;) {
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+
+        ssize_t len = ::read(fd_, buf, sizeof(buf));
+        if (len <= 0) {
+            continue;
+        }
+
+        for (char* p = buf; p < buf + len; ) {
+            auto const* ev = reinterpret_cast<inotify_event const*>(p);
+            p += sizeof(inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                notify("");
+                continue;
+            }
+
+            std::vector<std::string> paths;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = paths_.find(ev->wd);
+                if (it == paths_.end()) {
+                    continue;
+                }
+                paths = std::move(it->second);
+                paths_.erase(it);
+                for (auto const& path : paths) {
+                    if (auto w = watched_.find(path); w != watched_.end() && w->second.wd == ev->wd) {
+                        if (!w->second.pinned) {
+                            lru_.erase(w->second.lru);
+                        }
+                        watched_.erase(w);
+                    }
+                }
+            }
+            for (auto const& path : paths) {
+                notify(path);
+            }
+        }
+    }
+}
@@ -0,0 +1,185 @@
+#include "../../include/util/metrics.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+/**
+ * @brief Exported name, help text and type of a counter.
+ */
+struct counter_info
+{
+    char const* name;
+    char const* help;
+    char const* type;
+};
+
+constexpr std::array<counter_info, metrics::counter_count> counter_infos{{
+    {"server_accepts_total", "Accepted TCP connections.", "counter"},
+    {"server_tls_detected_total", "Connections detected as TLS.", "counter"},
+    {"server_plain_detected_total", "Connections detected as plain HTTP.", "counter"},
+    {"server_http_sessions_active", "Open HTTP sessions.", "gauge"},
+    {"server_websocket_sessions_active", "Open WebSocket sessions.", "gauge"},
+    {"server_http_queued_responses", "Responses waiting in HTTP pipelines.", "gauge"},
+    {"server_http_requests_total", "HTTP requests handled.", "counter"},
+    {"server_bytes_received_total", "HTTP and WebSocket payload bytes read.", "counter"},
+    {"server_bytes_sent_total", "HTTP and WebSocket payload bytes written.", "counter"},
+    {"server_tls_full_handshakes_total", "TLS handshakes that negotiated a new session.", "counter"},
+    {"server_tls_resumed_handshakes_total", "TLS handshakes that resumed a session.", "counter"},
+    {"server_tls_session_cache_hits_total", "Session IDs found in the TLS session cache.", "counter"},
+    {"server_tls_session_cache_misses_total", "Session IDs not found in the TLS session cache.", "counter"},
+    {"server_tls_ticket_hits_total", "TLS session tickets opened with a known key.", "counter"},
+    {"server_tls_ticket_misses_total", "TLS session tickets sealed with an unknown or expired key.", "counter"},
+    {"server_tls_handshakes_offloaded", "TLS handshakes queued or running on the crypto pool.", "gauge"},
+    {"server_tls_reloads_total", "SSL contexts rebuilt and published after startup.", "counter"},
+    {"server_tls_reload_failures_total", "SSL context rebuilds that failed.", "counter"},
+}};
+
+constexpr std::array<char const*, metrics::stage_count> stage_names{
+    "accept_to_detect", "detect_to_first_byte", "handshake_queue", "tls_handshake", "parse", "handle", "write"};
+
+constexpr std::array<double, 5> reported_quantiles{0.5, 0.9, 0.99, 0.999, 0.9999};
+constexpr std::array<char const*, 5> quantile_labels{"p50", "p90", "p99", "p99.9", "p99.99"};
+
+} // namespace
+
+/**
+ * @brief Access the shard registry.
+ */
+metrics::registry& metrics::shards()
+{
+    static registry instance;
+    return instance;
+}
+
+/**
+ * @brief Allocate a shard and add it to the registry.
+ */
+metrics::shard* metrics::register_shard()
+{
+    auto& reg = shards();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.shards.push_back(std::make_unique<shard>());
+    return reg.shards.back().get();
+}
+
+/**
+ * @brief Merge the histograms of one stage over all shards.
+ */
+hdr_histogram::snapshot metrics::merge(stage s)
+{
+    hdr_histogram::snapshot counts{};
+    auto& reg = shards();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for(auto const& sh : reg.shards)
+        sh->stages[s].add_to(counts);
+    return counts;
+}
+
+/**
+ * @brief Record the latency of a completed request.
+ *
+ * @param latency The time from the first request byte to the last response byte.
+ */
+void metrics::observe_latency(std::chrono::steady_clock::duration latency)
+{
+    auto const us = static_cast<std::uint64_t>(std::max<std::int64_t>(
+        0, std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+
+    auto const bucket = static_cast<std::size_t>(
+        std::lower_bound(latency_bounds_us.begin(), latency_bounds_us.end(), us) - latency_bounds_us.begin());
+
+    auto& s = local();
+    auto& count = s.latency_buckets[bucket];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    s.latency_sum_us.store(s.latency_sum_us.load(std::memory_order_relaxed) + us, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sum all shards and format them for a scrape.
+ *
+ * @return The metrics in the Prometheus text exposition format.
+ */
+std::string metrics::render()
+{
+    std::array<std::int64_t, counter_count> counters{};
+    std::array<std::uint64_t, latency_bounds_us.size() + 1> buckets{};
+    std::uint64_t sum_us = 0;
+
+    {
+        auto& reg = shards();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for(auto const& s : reg.shards)
+        {
+            for(std::size_t i = 0; i < counters.size(); ++i)
+                counters[i] += s->counters[i].load(std::memory_order_relaxed);
+            for(std::size_t i = 0; i < buckets.size(); ++i)
+                buckets[i] += s->latency_buckets[i].load(std::memory_order_relaxed);
+            sum_us += s->latency_sum_us.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::ostringstream out;
+    for(std::size_t i = 0; i < counters.size(); ++i)
+    {
+        auto const& info = counter_infos[i];
+        out << "# HELP " << info.name << ' ' << info.help << '\n'
+            << "# TYPE " << info.name << ' ' << info.type << '\n'
+            << info.name << ' ' << counters[i] << '\n';
+    }
+
+    char const* const latency = "server_http_request_duration_seconds";
+    out << "# HELP " << latency << " Time from the first request byte to the last response byte.\n"
+        << "# TYPE " << latency << " histogram\n";
+
+    std::uint64_t cumulative = 0;
+    for(std::size_t i = 0; i < latency_bounds_us.size(); ++i)
+    {
+        cumulative += buckets[i];
+        out << latency << "_bucket{le=\"" << latency_bounds_us[i] / 1e6 << "\"} " << cumulative << '\n';
+    }
+    cumulative += buckets.back();
+    out << latency << "_bucket{le=\"+Inf\"} " << cumulative << '\n'
+        << latency << "_sum " << sum_us / 1e6 << '\n'
+        << latency << "_count " << cumulative << '\n';
+
+    char const* const stages = "server_stage_duration_seconds";
+    out << "# HELP " << stages << " Latency of each pipeline stage.\n"
+        << "# TYPE " << stages << " summary\n";
+    for(std::size_t s = 0; s < stage_count; ++s)
+    {
+        auto const counts = merge(static_cast<stage>(s));
+        for(auto q : reported_quantiles)
+            out << stages << "{stage=\"" << stage_names[s] << "\",quantile=\"" << q << "\"} "
+                << hdr_histogram::value_at_quantile(counts, q) / 1e6 << '\n';
+        out << stages << "_count{stage=\"" << stage_names[s] << "\"} " << hdr_histogram::total(counts) << '\n';
+    }
+
+    return out.str();
+}
+
+/**
+ * @brief Merge the stage histograms of all shards into a readable table.
+ *
+ * @return One line per stage with its count and latency percentiles in microseconds.
+ */
+std::string metrics::render_stages()
+{
+    std::ostringstream out;
+    out << std::left << std::setw(22) << "stage" << std::right << std::setw(12) << "count";
+    for(auto label : quantile_labels)
+        out << std::setw(10) << label;
+    out << std::setw(12) << "max" << "  (us)\n";
+
+    for(std::size_t s = 0; s < stage_count; ++s)
+    {
+        auto const counts = merge(static_cast<stage>(s));
+        out << std::left << std::setw(22) << stage_names[s]
+            << std::right << std::setw(12) << hdr_histogram::total(counts);
+        for(auto q : reported_quantiles)
+            out << std::setw(10) << hdr_histogram::value_at_quantile(counts, q);
+        out << std::setw(12) << hdr_histogram::value_at_quantile(counts, 1.0) << '\n';
+    }
+    return out.str();
+}
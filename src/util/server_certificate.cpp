@@ -15,21 +15,72 @@
  */
 std::string load_file_content(const std::string& file_path) {
     auto logger = LoggerManager::getLogger("server_certificate_logger", LogLevel::INFO);
-    logger->log(LogLevel::DEBUG, "Loading file content from: " + file_path);
+    LOG_DEBUG(logger, "Loading file content from: ", file_path);
 
     std::ifstream file(file_path);
     if (!file.is_open()) {
-        logger->log(LogLevel::ERROR, "Error opening file: " + file_path);
+        LOG_ERROR(logger, "Error opening file: ", file_path);
         throw std::runtime_error("Could not open file: " + file_path);
     }
     
     std::stringstream buffer;
     buffer << file.rdbuf();
     
-    logger->log(LogLevel::DEBUG, "File content loaded successfully.");
+    LOG_DEBUG(logger, "File content loaded successfully.");
     return buffer.str();
 }
 
+/**
+ * @brief Configure a server SSL context with a certificate, its private key, and DH parameters.
+ * 
+ * Every server context gets the same options, so a connection behaves the same
+ * whichever certificate SNI selects for it.
+ * 
+ * @param ctx The SSL context to configure.
+ * @param cert The PEM certificate chain.
+ * @param key The PEM private key.
+ * @param dh The PEM DH parameters.
+ * @param password The password of the private key.
+ */
+void configure_server_context(boost::asio::ssl::context& ctx, const std::string& cert, const std::string& key,
+                              const std::string& dh, const std::string& password)
+{
+    auto logger = LoggerManager::getLogger("server_certificate_logger", LogLevel::INFO);
+
+    LOG_DEBUG(logger, "Setting SSL context password callback.");
+    ctx.set_password_callback(
+        [password](std::size_t,
+                   boost::asio::ssl::context_base::password_purpose)
+        {
+            return password;
+        });
+
+    LOG_DEBUG(logger, "Configuring SSL context options.");
+    ctx.set_options(
+        boost::asio::ssl::context::default_workarounds |
+        boost::asio::ssl::context::no_sslv2 |
+        boost::asio::ssl::context::single_dh_use);
+
+    // A context may be released by a certificate reload while its connections are still
+    // open; without renegotiation, nothing calls back into it after the handshake.
+#ifdef SSL_OP_NO_RENEGOTIATION
+    SSL_CTX_set_options(ctx.native_handle(), SSL_OP_NO_RENEGOTIATION);
+#endif
+
+    LOG_DEBUG(logger, "Loading certificate chain.");
+    ctx.use_certificate_chain(
+        boost::asio::buffer(cert.data(), cert.size()));
+
+    LOG_DEBUG(logger, "Loading private key.");
+    ctx.use_private_key(
+        boost::asio::buffer(key.data(), key.size()),
+        boost::asio::ssl::context::file_format::pem);
+
+    LOG_DEBUG(logger, "Loading DH parameters.");
+    ctx.use_tmp_dh(
+        boost::asio::buffer(dh.data(), dh.size()));
+}
+
 /**
  * @brief Load the server certificate, private key, and DH parameters into the SSL context.
  * 
@@ -42,11 +93,11 @@ std::string load_file_content(const std::string& file_path) {
 void load_server_certificate(boost::asio::ssl::context& ctx)
 {
     auto logger = LoggerManager::getLogger("server_certificate_logger", LogLevel::INFO);
-    logger->log(LogLevel::DEBUG, "Loading server certificate.");
+    LOG_DEBUG(logger, "Loading server certificate.");
 
     // Load environment variables from the .env file
     dotenv::init(".env");
-    logger->log(LogLevel::DEBUG, "Environment variables loaded.");
+    LOG_DEBUG(logger, "Environment variables loaded.");
 
     // Retrieve file paths and password from the environment
     const char* cert_path = std::getenv("CERT_PATH");
@@ -56,11 +107,11 @@ void load_server_certificate(boost::asio::ssl::context& ctx)
 
     // Ensure all required environment variables are set
     if (!cert_path || !key_path || !dh_path || !password_cstr) {
-        logger->log(LogLevel::ERROR, "Missing one or more required environment variables.");
+        LOG_ERROR(logger, "Missing one or more required environment variables.");
         throw std::runtime_error("Missing one or more required environment variables");
     }
 
-    logger->log(LogLevel::DEBUG, "Environment variables found.");
+    LOG_DEBUG(logger, "Environment variables found.");
 
     // Load the contents of the certificate, key, and DH parameter files
     std::string cert = load_file_content(cert_path);
@@ -68,33 +119,8 @@ void load_server_certificate(boost::asio::ssl::context& ctx)
     std::string dh = load_file_content(dh_path);
     std::string password(password_cstr);
 
-    logger->log(LogLevel::DEBUG, "Setting SSL context password callback.");
-    ctx.set_password_callback(
-        [password](std::size_t,
-                   boost::asio::ssl::context_base::password_purpose)
-        {
-            return password;
-        });
-
-    logger->log(LogLevel::DEBUG, "Configuring SSL context options.");
-    ctx.set_options(
-        boost::asio::ssl::context::default_workarounds |
-        boost::asio::ssl::context::no_sslv2 |
-        boost::asio::ssl::context::single_dh_use);
-
-    logger->log(LogLevel::DEBUG, "Loading certificate chain.");
-    ctx.use_certificate_chain(
-        boost::asio::buffer(cert.data(), cert.size()));
-
-    logger->log(LogLevel::DEBUG, "Loading private key.");
-    ctx.use_private_key(
-        boost::asio::buffer(key.data(), key.size()),
-        boost::asio::ssl::context::file_format::pem);
-
-    logger->log(LogLevel::DEBUG, "Loading DH parameters.");
-    ctx.use_tmp_dh(
-        boost::asio::buffer(dh.data(), dh.size()));
+    configure_server_context(ctx, cert, key, dh, password);
 
-    logger->log(LogLevel::DEBUG, "Server certificate loaded successfully.");
+    LOG_DEBUG(logger, "Server certificate loaded successfully.");
 }
 
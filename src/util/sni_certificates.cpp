@@ -0,0 +1,181 @@
+#include "../../include/util/sni_certificates.hpp"
+#include "../../include/util/server_certificate.hpp"
+#include "../../include/util/tls_resumption.hpp"
+#include "../../include/log/log.hpp"
+#include <openssl/x509v3.h>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * @brief Lowercase an ASCII host name.
+ */
+std::string lowercase(std::string_view name)
+{
+    std::string result(name);
+    for(auto& c : result)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return result;
+}
+
+} // namespace
+
+/**
+ * @brief Load the certificates of a directory and select them on the default context.
+ *
+ * @param directory The directory holding "<name>.crt" and "<name>.key" pairs.
+ * @param dh The PEM DH parameters used by every context.
+ * @param password The password of the private keys.
+ * @param default_ctx The context connections start with; its session cache and ticket keys are shared.
+ * @return The number of certificates loaded.
+ */
+std::size_t sni_certificates::load(std::string const& directory, std::string const& dh, std::string const& password,
+                                   boost::asio::ssl::context& default_ctx)
+{
+    namespace fs = std::filesystem;
+    auto logger = LoggerManager::getLogger("sni_certificates_logger", LogLevel::INFO);
+
+    std::error_code ec;
+    fs::directory_iterator it(directory, ec);
+    if(ec)
+    {
+        LOG_ERROR(logger, "Cannot read certificate directory: ", directory);
+        throw std::runtime_error("Cannot read certificate directory: " + directory);
+    }
+
+    std::size_t names = 0;
+    for(auto const& file : it)
+    {
+        auto const& path = file.path();
+        if(path.extension() != ".crt")
+            continue;
+
+        auto key_path = path;
+        key_path.replace_extension(".key");
+        if(! fs::exists(key_path))
+        {
+            LOG_WARN(logger, "Skipping certificate without a key: ", path.string());
+            continue;
+        }
+
+        auto ctx = std::make_unique<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12);
+        configure_server_context(*ctx, load_file_content(path.string()), load_file_content(key_path.string()),
+                                 dh, password);
+        tls_resumption::share(ctx->native_handle());
+
+        auto const indexed = index(ctx->native_handle());
+        if(indexed == 0)
+            LOG_WARN(logger, "Certificate has no DNS names: ", path.string());
+        names += indexed;
+        contexts_.push_back(std::move(ctx));
+    }
+
+    if(! contexts_.empty())
+    {
+        SSL_CTX_set_tlsext_servername_callback(default_ctx.native_handle(), &sni_certificates::on_servername);
+        SSL_CTX_set_tlsext_servername_arg(default_ctx.native_handle(), this);
+    }
+
+    LOG_INFO(logger, "Loaded ", contexts_.size(), " SNI certificates for ", names, " names.");
+    return contexts_.size();
+}
+
+/**
+ * @brief Index the DNS names of a context's certificate.
+ *
+ * @param ctx The context.
+ * @return The number of names indexed.
+ */
+std::size_t sni_certificates::index(SSL_CTX* ctx)
+{
+    X509* cert = SSL_CTX_get0_certificate(ctx);
+    if(! cert)
+        return 0;
+
+    std::size_t count = 0;
+    auto* names = static_cast<GENERAL_NAMES*>(X509_get_ext_d2i(cert, NID_subject_alt_name, nullptr, nullptr));
+    if(names)
+    {
+        for(int i = 0; i < sk_GENERAL_NAME_num(names); ++i)
+        {
+            GENERAL_NAME const* name = sk_GENERAL_NAME_value(names, i);
+            if(name->type != GEN_DNS)
+                continue;
+            auto const* data = reinterpret_cast<char const*>(ASN1_STRING_get0_data(name->d.dNSName));
+            add(std::string(data, static_cast<std::size_t>(ASN1_STRING_length(name->d.dNSName))), ctx);
+            ++count;
+        }
+        GENERAL_NAMES_free(names);
+    }
+
+    // Without DNS alternative names, clients fall back to the common name.
+    if(count == 0)
+    {
+        X509_NAME* subject = X509_get_subject_name(cert);
+        int const index = X509_NAME_get_index_by_NID(subject, NID_commonName, -1);
+        if(index >= 0)
+        {
+            ASN1_STRING const* cn = X509_NAME_ENTRY_get_data(X509_NAME_get_entry(subject, index));
+            auto const* data = reinterpret_cast<char const*>(ASN1_STRING_get0_data(cn));
+            add(std::string(data, static_cast<std::size_t>(ASN1_STRING_length(cn))), ctx);
+            ++count;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Add one name, "*.example.com" for a wildcard, to the tables.
+ *
+ * The first certificate loaded for a name wins.
+ */
+void sni_certificates::add(std::string name, SSL_CTX* ctx)
+{
+    name = lowercase(name);
+    if(name.size() > 2 && name.compare(0, 2, "*.") == 0)
+        wildcard_.emplace(name.substr(2), ctx);
+    else
+        exact_.emplace(std::move(name), ctx);
+}
+
+/**
+ * @brief Find the context for a server name.
+ *
+ * A wildcard covers exactly one label, so only the parent domain is looked up.
+ *
+ * @param name The server name sent by the client, in any case.
+ * @return The context, or null to keep the default one.
+ */
+SSL_CTX* sni_certificates::find(std::string_view name) const
+{
+    if(! name.empty() && name.back() == '.')
+        name.remove_suffix(1);
+    auto const host = lowercase(name);
+
+    if(auto it = exact_.find(host); it != exact_.end())
+        return it->second;
+
+    auto const dot = host.find('.');
+    if(dot != std::string::npos && dot != 0)
+        if(auto it = wildcard_.find(host.substr(dot + 1)); it != wildcard_.end())
+            return it->second;
+
+    return nullptr;
+}
+
+/**
+ * @brief OpenSSL callback switching the connection to the context of its server name.
+ */
+int sni_certificates::on_servername(SSL* ssl, int*, void* arg)
+{
+    char const* name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if(! name)
+        return SSL_TLSEXT_ERR_NOACK;
+
+    if(SSL_CTX* ctx = static_cast<sni_certificates const*>(arg)->find(name))
+        SSL_set_SSL_CTX(ssl, ctx);
+    return SSL_TLSEXT_ERR_OK;
+}
@@ -0,0 +1,105 @@
+#include "../../include/util/timestamp.hpp"
+#include <ctime>
+#include <string>
+
+namespace {
+
+/**
+ * @brief A preformatted string for one second, with room for a fractional suffix.
+ */
+struct cached_second
+{
+    std::time_t second = -1;    ///< The second the text was formatted for
+    std::size_t size = 0;       ///< Length of the second-resolution text
+    char text[40];              ///< The formatted text
+};
+
+/**
+ * @brief Split a time point into whole seconds and microseconds.
+ */
+std::time_t split(timestamp::clock::time_point tp, long& micros)
+{
+    auto const us = std::chrono::duration_cast<std::chrono::microseconds>(
+        tp.time_since_epoch()).count();
+    auto sec = us / 1000000;
+    micros = static_cast<long>(us % 1000000);
+    if(micros < 0)
+    {
+        micros += 1000000;
+        --sec;
+    }
+    return static_cast<std::time_t>(sec);
+}
+
+/**
+ * @brief Refresh the local-time cache if the second changed.
+ */
+cached_second& local_second(std::time_t sec)
+{
+    thread_local cached_second cache;
+    if(cache.second != sec)
+    {
+        std::tm tm;
+        localtime_r(&sec, &tm);
+        cache.size = std::strftime(cache.text, sizeof(cache.text), "%Y-%m-%d %H:%M:%S", &tm);
+        cache.second = sec;
+    }
+    return cache;
+}
+
+} // namespace
+
+std::string_view timestamp::local(clock::time_point tp)
+{
+    long micros;
+    cached_second& cache = local_second(split(tp, micros));
+    return {cache.text, cache.size};
+}
+
+std::string_view timestamp::local_micros(clock::time_point tp)
+{
+    long micros;
+    cached_second& cache = local_second(split(tp, micros));
+
+    // Write ".uuuuuu" after the cached seconds; the prefix is left untouched.
+    char* p = cache.text + cache.size;
+    *p = '.';
+    for(int i = 6; i > 0; --i)
+    {
+        p[i] = static_cast<char>('0' + micros % 10);
+        micros /= 10;
+    }
+    return {cache.text, cache.size + 7};
+}
+
+std::string_view timestamp::http_date(clock::time_point tp)
+{
+    thread_local cached_second cache;
+
+    long micros;
+    std::time_t sec = split(tp, micros);
+    if(cache.second != sec)
+    {
+        std::tm tm;
+        gmtime_r(&sec, &tm);
+        cache.size = std::strftime(cache.text, sizeof(cache.text), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        cache.second = sec;
+    }
+    return {cache.text, cache.size};
+}
+
+bool timestamp::parse_http_date(std::string_view text, std::time_t& sec)
+{
+    // IMF-fixdate has a fixed length; anything else (obsolete formats included) is rejected.
+    if(text.size() != 29)
+        return false;
+
+    std::string const copy(text);
+    std::tm tm{};
+    char const* end = strptime(copy.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if(end == nullptr || *end != '\0')
+        return false;
+
+    sec = timegm(&tm);
+    return true;
+}
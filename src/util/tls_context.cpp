@@ -0,0 +1,170 @@
+#include "../../include/util/tls_context.hpp"
+#include "../../include/util/file_watcher.hpp"
+#include "../../include/util/metrics.hpp"
+#include "../../include/log/log.hpp"
+#include <algorithm>
+#include <exception>
+#include <sys/stat.h>
+
+/**
+ * @brief Access the shared instance.
+ *
+ * @return A reference to the process-wide instance.
+ */
+tls_context& tls_context::instance()
+{
+    static tls_context context;
+    return context;
+}
+
+/**
+ * @brief Build the first context and start the reload thread.
+ *
+ * @param build The function building a context, called again on every reload.
+ * @param watched Files and directories whose changes trigger a reload.
+ */
+void tls_context::configure(builder build, std::vector<std::string> watched)
+{
+    auto logger = LoggerManager::getLogger("tls_context_logger", LogLevel::INFO);
+
+    build_ = std::move(build);
+    watched_ = std::move(watched);
+    built_from_ = fingerprint();
+    current_.store(build_(), std::memory_order_release);
+
+    pool_ = std::make_unique<net::thread_pool>(1);
+    timer_ = std::make_unique<net::steady_timer>(pool_->get_executor());
+
+    if(watched_.empty())
+        return;
+    if(! file_watcher::instance().available())
+    {
+        LOG_WARN(logger, "inotify unavailable; certificates are only reloaded on SIGHUP.");
+        return;
+    }
+
+    // Certificate renewals usually replace the chain and the key one after the
+    // other, so wait for both before rebuilding.
+    file_watcher::instance().subscribe([this](std::string const& path)
+    {
+        if(path.empty() || std::find(watched_.begin(), watched_.end(), path) != watched_.end())
+            schedule(std::chrono::milliseconds(500));
+    });
+    watch();
+    LOG_INFO(logger, "Watching ", watched_.size(), " certificate paths for changes.");
+}
+
+/**
+ * @brief Rebuild the context on the reload thread, whether or not the files changed.
+ *
+ * @param delay How long to wait first, letting related file changes settle.
+ */
+void tls_context::reload(std::chrono::milliseconds delay)
+{
+    forced_ = true;
+    schedule(delay);
+}
+
+/**
+ * @brief Schedule a rebuild on the reload thread, merged with a pending one.
+ *
+ * @param delay How long to wait first.
+ */
+void tls_context::schedule(std::chrono::milliseconds delay)
+{
+    if(! pool_ || pending_.exchange(true))
+        return;
+
+    timer_->expires_after(delay);
+    timer_->async_wait([this](beast::error_code ec)
+    {
+        pending_ = false;
+        if(! ec)
+            rebuild(forced_.exchange(false));
+    });
+}
+
+/**
+ * @brief Watch the configured paths until their next change.
+ *
+ * Watches are one-shot, and a renewal may replace a file rather than rewrite it,
+ * so they are installed again before every rebuild.
+ */
+void tls_context::watch()
+{
+    if(! file_watcher::instance().available())
+        return;
+    for(auto const& path : watched_)
+        file_watcher::instance().watch(path, true);
+}
+
+/**
+ * @brief Describe the watched paths as they are on disk now.
+ *
+ * A renewal that rewrites a file changes its size or times; one that replaces it
+ * changes its inode. A directory changes when entries are added or renamed.
+ *
+ * @return Device, inode, size, mtime and ctime of each path, zeros if it is missing.
+ */
+std::vector<std::uint64_t> tls_context::fingerprint() const
+{
+    std::vector<std::uint64_t> result;
+    result.reserve(watched_.size() * 5);
+    for(auto const& path : watched_)
+    {
+        struct stat st{};
+        if(::stat(path.c_str(), &st) != 0)
+            st = {};
+        result.push_back(static_cast<std::uint64_t>(st.st_dev));
+        result.push_back(static_cast<std::uint64_t>(st.st_ino));
+        result.push_back(static_cast<std::uint64_t>(st.st_size));
+        result.push_back(static_cast<std::uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+        result.push_back(static_cast<std::uint64_t>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec);
+    }
+    return result;
+}
+
+/**
+ * @brief Build a context and publish it, keeping the current one on failure.
+ *
+ * @param forced Whether to rebuild even if the watched paths look unchanged.
+ */
+void tls_context::rebuild(bool forced)
+{
+    auto logger = LoggerManager::getLogger("tls_context_logger", LogLevel::INFO);
+    watch();
+
+    // Lost inotify events are reported for every file; most leave the certificates alone.
+    auto stamp = fingerprint();
+    if(! forced && stamp == built_from_)
+    {
+        LOG_DEBUG(logger, "Certificate files unchanged; keeping the current SSL context.");
+        return;
+    }
+
+    try
+    {
+        auto ctx = build_();
+        built_from_ = std::move(stamp);
+        current_.store(std::move(ctx), std::memory_order_release);
+        metrics::add(metrics::tls_reloads);
+        LOG_INFO(logger, "SSL context reloaded; new handshakes use the new certificates.");
+    }
+    catch(std::exception const& e)
+    {
+        metrics::add(metrics::tls_reload_failures);
+        LOG_ERROR(logger, "SSL context reload failed, keeping the current one: ", e.what());
+    }
+}
+
+/**
+ * @brief Cancel a pending reload and wait for one in progress.
+ */
+tls_context::~tls_context()
+{
+    if(pool_)
+    {
+        pool_->stop();
+        pool_->join();
+    }
+}
@@ -0,0 +1,139 @@
+#include "../../include/util/tls_records.hpp"
+#include "../../include/log/log.hpp"
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <algorithm>
+
+namespace {
+
+/// Largest record payload TLS allows.
+constexpr std::size_t max_record_size = SSL3_RT_MAX_PLAIN_LENGTH;
+
+/// Smallest maximum fragment OpenSSL accepts.
+constexpr std::size_t min_record_size = 512;
+
+/// Header, explicit nonce and tag of an AES-GCM record, the largest of the usual ciphers.
+constexpr std::size_t record_overhead = 29;
+
+} // namespace
+
+/**
+ * @brief Access the shared instance.
+ *
+ * @return A reference to the process-wide instance.
+ */
+tls_records& tls_records::instance()
+{
+    static tls_records records;
+    return records;
+}
+
+/**
+ * @brief Enable dynamic record sizing.
+ *
+ * @param small_size The payload of a small record, 0 to derive it from each connection's MSS.
+ * @param boost_after Bytes a connection sends in small records before switching, 0 to disable.
+ * @param idle Time without sending after which a connection goes back to small records.
+ */
+void tls_records::configure(std::size_t small_size, std::size_t boost_after, std::chrono::milliseconds idle)
+{
+    if(boost_after == 0)
+        return;
+
+    small_size_ = small_size == 0 ? 0 : std::clamp(small_size, min_record_size, max_record_size);
+    boost_after_ = boost_after;
+    idle_ = idle;
+
+    auto logger = LoggerManager::getLogger("tls_records_logger", LogLevel::INFO);
+    if(small_size_ == 0)
+        LOG_INFO(logger, "Dynamic TLS records enabled: one segment each for the first ", boost_after_, " bytes.");
+    else
+        LOG_INFO(logger, "Dynamic TLS records enabled: ", small_size_, " bytes each for the first ", boost_after_, " bytes.");
+}
+
+/**
+ * @brief Start sizing the records of a connection whose handshake is complete.
+ *
+ * @param ssl The connection.
+ * @param fd The connection's socket, to read its MSS from.
+ */
+void tls_records::sizer::attach(SSL* ssl, int fd)
+{
+    auto const& config = instance();
+    if(! config.enabled())
+        return;
+
+    small_ = config.small_size_;
+    if(small_ == 0)
+    {
+        int mss = 0;
+        socklen_t length = sizeof(mss);
+        if(getsockopt(fd, IPPROTO_TCP, TCP_MAXSEG, &mss, &length) == 0 && mss > 0)
+            small_ = static_cast<std::size_t>(mss) > record_overhead ? mss - record_overhead : 0;
+        small_ = std::clamp(small_, min_record_size, max_record_size);
+    }
+
+    sent_ = 0;
+    full_ = small_ == max_record_size;
+    last_sent_ = std::chrono::steady_clock::now();
+
+    SSL_set_max_send_fragment(ssl, full_ ? max_record_size : small_);
+    SSL_set_msg_callback_arg(ssl, this);
+    SSL_set_msg_callback(ssl, &tls_records::sizer::on_record);
+}
+
+/**
+ * @brief Pick the record size for the next response or message.
+ *
+ * Growing is deferred to this point because OpenSSL keeps the write buffer it
+ * allocated for the current maximum while a write is in progress, and a larger
+ * record would not fit in it. Between writes the buffers can be freed, unless
+ * received data is still waiting in them, in which case the switch waits for
+ * the next write.
+ *
+ * @param ssl The connection.
+ */
+void tls_records::sizer::before_write(SSL* ssl)
+{
+    if(small_ == 0)
+        return;
+
+    auto const& config = instance();
+    if(std::chrono::steady_clock::now() - last_sent_ > config.idle_)
+    {
+        // The window may have collapsed while idle; a smaller record always fits the buffer.
+        if(full_)
+            SSL_set_max_send_fragment(ssl, small_);
+        full_ = false;
+        sent_ = 0;
+    }
+    else if(! full_ && sent_ >= config.boost_after_ && SSL_free_buffers(ssl) == 1)
+    {
+        // Lowering the maximum lowered the split fragment with it; raise both.
+        SSL_set_max_send_fragment(ssl, max_record_size);
+        SSL_set_split_send_fragment(ssl, max_record_size);
+        full_ = true;
+    }
+}
+
+/**
+ * @brief OpenSSL callback seeing the header of every record.
+ *
+ * Counts the payload of sent records, which all carry the application data type
+ * once encrypted, and notes when the last one was sent.
+ */
+void tls_records::sizer::on_record(int write_p, int, int content_type,
+                                   void const* buf, std::size_t len, SSL*, void* arg)
+{
+    if(! write_p || content_type != SSL3_RT_HEADER || len < SSL3_RT_HEADER_LENGTH)
+        return;
+    auto const* header = static_cast<unsigned char const*>(buf);
+    if(header[0] != SSL3_RT_APPLICATION_DATA)
+        return;
+
+    auto& self = *static_cast<sizer*>(arg);
+    self.last_sent_ = std::chrono::steady_clock::now();
+    if(! self.full_)
+        self.sent_ += (std::size_t(header[3]) << 8) | header[4];
+}
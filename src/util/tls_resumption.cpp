@@ -0,0 +1,310 @@
+#include "../../include/util/tls_resumption.hpp"
+#include "../../include/util/metrics.hpp"
+#include "../../include/log/log.hpp"
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+/**
+ * @brief Access the shared instance.
+ *
+ * @return A reference to the process-wide instance.
+ */
+tls_resumption& tls_resumption::instance()
+{
+    static tls_resumption resumption;
+    return resumption;
+}
+
+/**
+ * @brief Size the session cache and start the ticket key rotation.
+ *
+ * @param cache_size The maximum number of cached sessions, 0 to disable the server-side cache.
+ * @param ticket_rotation How often a new ticket key is generated, 0 to disable tickets.
+ */
+void tls_resumption::configure(std::size_t cache_size, std::chrono::seconds ticket_rotation)
+{
+    auto logger = LoggerManager::getLogger("tls_resumption_logger", LogLevel::INFO);
+
+    if(cache_size != 0)
+    {
+        shard_capacity_ = std::max<std::size_t>(1, cache_size / shard_count);
+        LOG_INFO(logger, "TLS session cache enabled with ", shard_capacity_ * shard_count, " sessions.");
+    }
+
+    if(ticket_rotation.count() > 0)
+    {
+        std::lock_guard<std::mutex> lock(keys_mutex_);
+        rotation_ = ticket_rotation;
+        rotate();
+        LOG_INFO(logger, "TLS session tickets enabled, keys rotated every ", ticket_rotation.count(), " s.");
+    }
+}
+
+/**
+ * @brief Install the session cache and ticket key callbacks on a context.
+ *
+ * @param ctx The server context.
+ */
+void tls_resumption::apply(SSL_CTX* ctx)
+{
+    share(ctx);
+
+    if(shard_capacity_ != 0)
+    {
+        // OpenSSL's own cache is a single locked table; keep only the sharded one.
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+        SSL_CTX_sess_set_new_cb(ctx, &tls_resumption::new_session);
+        SSL_CTX_sess_set_get_cb(ctx, &tls_resumption::get_session);
+        SSL_CTX_sess_set_remove_cb(ctx, &tls_resumption::remove_session);
+    }
+    else
+    {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    }
+
+    if(rotation_.count() > 0)
+    {
+        // A session outlives its ticket key by at most the keys still accepted.
+        SSL_CTX_set_timeout(ctx, static_cast<long>(rotation_.count() * key_count));
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, &tls_resumption::ticket_key_cb);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(ctx, &tls_resumption::ticket_key_cb);
+#endif
+    }
+    else
+    {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    }
+}
+
+/**
+ * @brief Let sessions established on a default context resume on another one.
+ *
+ * @param ctx A context that connections may be switched to.
+ */
+void tls_resumption::share(SSL_CTX* ctx)
+{
+    static constexpr unsigned char id_context[] = "beast-server";
+    SSL_CTX_set_session_id_context(ctx, id_context, sizeof(id_context) - 1);
+}
+
+/**
+ * @brief Keep a connection's session resumable however the connection ended.
+ *
+ * @param ssl The connection, or null if the stream was moved from.
+ */
+void tls_resumption::keep_resumable(SSL* ssl)
+{
+    if(ssl)
+        SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+}
+
+/**
+ * @brief Pick the shard of a session ID.
+ */
+tls_resumption::shard& tls_resumption::shard_for(std::string const& id)
+{
+    return shards_[std::hash<std::string>{}(id) % shard_count];
+}
+
+/**
+ * @brief Generate a new current key if the rotation is due. Must be called with keys_mutex_ held.
+ *
+ * The oldest key is wiped and dropped, so tickets it sealed fall back to a full handshake.
+ */
+void tls_resumption::rotate()
+{
+    auto const now = std::chrono::steady_clock::now();
+    if(keys_used_ != 0 && now < next_rotation_)
+        return;
+
+    OPENSSL_cleanse(&keys_.back(), sizeof(ticket_key));
+    std::rotate(keys_.rbegin(), keys_.rbegin() + 1, keys_.rend());
+
+    auto& key = keys_.front();
+    if(RAND_bytes(key.name, sizeof(key.name)) != 1
+        || RAND_bytes(key.aes, sizeof(key.aes)) != 1
+        || RAND_bytes(key.hmac, sizeof(key.hmac)) != 1)
+        throw std::runtime_error("Could not generate a TLS ticket key");
+
+    keys_used_ = std::min(keys_used_ + 1, key_count);
+    next_rotation_ = now + rotation_;
+}
+
+/**
+ * @brief Select the key for sealing a new ticket, or find the key of a received one.
+ *
+ * @param name The key name, written when sealing and read when opening.
+ * @param key Receives the key material.
+ * @param seal True to seal a new ticket.
+ * @return 1 for the current key, 2 for a previous one (the ticket is renewed), 0 if unknown.
+ */
+int tls_resumption::select_key(unsigned char* name, ticket_key& key, bool seal)
+{
+    std::lock_guard<std::mutex> lock(keys_mutex_);
+    rotate();
+
+    if(seal)
+    {
+        key = keys_.front();
+        std::memcpy(name, key.name, sizeof(key.name));
+        return 1;
+    }
+
+    for(std::size_t i = 0; i < keys_used_; ++i)
+    {
+        if(std::memcmp(name, keys_[i].name, sizeof(keys_[i].name)) != 0)
+            continue;
+        key = keys_[i];
+        return i == 0 ? 1 : 2;
+    }
+    return 0;
+}
+
+/**
+ * @brief OpenSSL callback initializing the cipher and MAC for sealing or opening a ticket.
+ *
+ * @return 1 to use the ticket, 2 to use it and issue a fresh one, 0 to ignore it, -1 on error.
+ */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int tls_resumption::ticket_key_cb(SSL*, unsigned char* name, unsigned char* iv,
+                                  EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int seal)
+#else
+int tls_resumption::ticket_key_cb(SSL*, unsigned char* name, unsigned char* iv,
+                                  EVP_CIPHER_CTX* cipher, HMAC_CTX* mac, int seal)
+#endif
+{
+    ticket_key key;
+    int const result = instance().select_key(name, key, seal != 0);
+    if(result == 0)
+    {
+        metrics::add(metrics::tls_ticket_misses);
+        return 0;
+    }
+
+    if(seal && RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+        return -1;
+
+    int const cipher_ok = seal
+        ? EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes, iv)
+        : EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes, iv);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac, sizeof(key.hmac)),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()};
+    int const mac_ok = EVP_MAC_CTX_set_params(mac, params);
+#else
+    int const mac_ok = HMAC_Init_ex(mac, key.hmac, sizeof(key.hmac), EVP_sha256(), nullptr);
+#endif
+
+    OPENSSL_cleanse(&key, sizeof(key));
+    if(cipher_ok != 1 || mac_ok != 1)
+        return -1;
+
+    if(! seal)
+        metrics::add(metrics::tls_ticket_hits);
+    return result;
+}
+
+/**
+ * @brief OpenSSL callback storing a new session. Returns 0, as no reference is kept.
+ */
+int tls_resumption::new_session(SSL*, SSL_SESSION* sess)
+{
+    unsigned int length = 0;
+    unsigned char const* raw = SSL_SESSION_get_id(sess, &length);
+    if(length == 0)
+        return 0;
+    std::string id(reinterpret_cast<char const*>(raw), length);
+
+    int const size = i2d_SSL_SESSION(sess, nullptr);
+    if(size <= 0)
+        return 0;
+    std::string der(static_cast<std::size_t>(size), '\0');
+    auto* out = reinterpret_cast<unsigned char*>(der.data());
+    i2d_SSL_SESSION(sess, &out);
+
+    auto& self = instance();
+    auto& s = self.shard_for(id);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    if(auto it = s.sessions.find(id); it != s.sessions.end())
+    {
+        it->second.der = std::move(der);
+        s.lru.splice(s.lru.begin(), s.lru, it->second.lru);
+        return 0;
+    }
+
+    s.lru.push_front(id);
+    s.sessions.emplace(std::move(id), session{std::move(der), s.lru.begin()});
+    if(s.sessions.size() > self.shard_capacity_)
+    {
+        s.sessions.erase(s.lru.back());
+        s.lru.pop_back();
+    }
+    return 0;
+}
+
+/**
+ * @brief OpenSSL callback looking up a session by ID.
+ *
+ * OpenSSL checks the returned session's age and context itself.
+ */
+SSL_SESSION* tls_resumption::get_session(SSL*, unsigned char const* id, int length, int* copy)
+{
+    *copy = 0;
+
+    std::string der;
+    {
+        std::string const key(reinterpret_cast<char const*>(id), static_cast<std::size_t>(length));
+        auto& s = instance().shard_for(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.sessions.find(key);
+        if(it != s.sessions.end())
+        {
+            s.lru.splice(s.lru.begin(), s.lru, it->second.lru);
+            der = it->second.der;
+        }
+    }
+
+    if(der.empty())
+    {
+        metrics::add(metrics::tls_cache_misses);
+        return nullptr;
+    }
+
+    auto const* in = reinterpret_cast<unsigned char const*>(der.data());
+    SSL_SESSION* sess = d2i_SSL_SESSION(nullptr, &in, static_cast<long>(der.size()));
+    metrics::add(sess ? metrics::tls_cache_hits : metrics::tls_cache_misses);
+    return sess;
+}
+
+/**
+ * @brief OpenSSL callback dropping a session that is no longer valid.
+ */
+void tls_resumption::remove_session(SSL_CTX*, SSL_SESSION* sess)
+{
+    unsigned int length = 0;
+    unsigned char const* raw = SSL_SESSION_get_id(sess, &length);
+    std::string const id(reinterpret_cast<char const*>(raw), length);
+
+    auto& s = instance().shard_for(id);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if(auto it = s.sessions.find(id); it != s.sessions.end())
+    {
+        s.lru.erase(it->second.lru);
+        s.sessions.erase(it);
+    }
+}